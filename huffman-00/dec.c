@@ -3,6 +3,7 @@
 #include <string.h>
 
 #define MAX_CHARS 256 // Using extended ASCII range
+#define IO_BLOCK (1 << 16) // Bytes per fread/fwrite
 
 // --- Data Structures ---
 
@@ -104,8 +105,10 @@ void decodeFile(const char* input_path, const char* output_path) {
         FILE* output_file = fopen(output_path, "wb");
         if(output_file) {
             if(original_file_size > 0 && root && root->freq > 0) {
-                 for(long i = 0; i < original_file_size; ++i) {
-                    fputc(root->data, output_file);
+                unsigned char block[IO_BLOCK];
+                memset(block, (unsigned char)root->data, IO_BLOCK);
+                for(long left = original_file_size; left > 0; left -= IO_BLOCK) {
+                    fwrite(block, 1, left < IO_BLOCK ? (size_t)left : IO_BLOCK, output_file);
                 }
             }
             fclose(output_file);
@@ -125,9 +128,24 @@ void decodeFile(const char* input_path, const char* output_path) {
         exit(1);
     }
 
-    int c;
+    // Block buffers with manual cursors: in_pos/in_len over the input
+    // block, out_len over the output block
+    unsigned char* in_block = (unsigned char*)malloc(IO_BLOCK);
+    unsigned char* out_block = (unsigned char*)malloc(IO_BLOCK);
+    if (!in_block || !out_block) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(1);
+    }
+    size_t in_pos = 0, in_len = 0, out_len = 0;
+
     long decoded_count = 0;
-    while (decoded_count < original_file_size && (c = fgetc(input_file)) != EOF) {
+    while (decoded_count < original_file_size) {
+        if (in_pos == in_len) {
+            in_len = fread(in_block, 1, IO_BLOCK, input_file);
+            in_pos = 0;
+            if (in_len == 0) break;
+        }
+        int c = in_block[in_pos++];
         for (int i = 7; i >= 0; i--) {
             if (decoded_count >= original_file_size) break;
 
@@ -145,7 +163,11 @@ void decodeFile(const char* input_path, const char* output_path) {
 
             // If it's a leaf node
             if (current_node->left == NULL && current_node->right == NULL) {
-                fputc(current_node->data, output_file);
+                out_block[out_len++] = (unsigned char)current_node->data;
+                if (out_len == IO_BLOCK) {
+                    fwrite(out_block, 1, out_len, output_file);
+                    out_len = 0;
+                }
                 decoded_count++;
                 current_node = root; // Go back to the root for the next character
             }
@@ -154,6 +176,9 @@ void decodeFile(const char* input_path, const char* output_path) {
 
 cleanup:
     // --- Cleanup ---
+    fwrite(out_block, 1, out_len, output_file);
+    free(in_block);
+    free(out_block);
     fclose(input_file);
     fclose(output_file);
     freeTree(root);
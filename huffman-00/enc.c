@@ -3,6 +3,8 @@
 #include <string.h>
 
 #define MAX_CHARS 256 // Using extended ASCII range
+#define IO_BLOCK (1 << 16) // Bytes per fread/fwrite
+#define PACKED_BITS 56     // Longest code kept as a bit pattern
 
 // --- Data Structures ---
 
@@ -13,6 +15,21 @@ typedef struct Node {
     struct Node *left, *right;
 } Node;
 
+// A code as a right-aligned bit pattern, for codes up to PACKED_BITS long
+typedef struct Code {
+    unsigned long long bits;
+    int len;
+} Code;
+
+// Output block with a manual byte cursor and a bit accumulator
+typedef struct BitWriter {
+    FILE* file;
+    unsigned char block[IO_BLOCK];
+    size_t used;
+    unsigned long long acc;
+    int pending;
+} BitWriter;
+
 // A Min Heap: used as a priority queue for nodes
 typedef struct MinHeap {
     unsigned size;
@@ -33,6 +50,9 @@ void buildMinHeap(MinHeap* minHeap);
 Node* buildHuffmanTree(unsigned freq[], int size);
 void storeCodes(Node* root, char* codes[], char current_code[], int top);
 void freeTree(Node* root);
+void packCodes(char* codes[], Code packed[]);
+void writeCode(BitWriter* writer, const Code* code, const char* text);
+void flushBlock(BitWriter* writer);
 
 // Main Encoder Function
 void encodeFile(const char* input_path, const char* output_path);
@@ -75,10 +95,17 @@ void encodeFile(const char* input_path, const char* output_path) {
         perror("Error opening input file");
         exit(1);
     }
-    int c;
-    while ((c = fgetc(input_file)) != EOF) {
-        freq[c]++;
-        original_file_size++;
+    unsigned char* block = (unsigned char*)malloc(IO_BLOCK);
+    if (!block) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(1);
+    }
+    size_t got;
+    while ((got = fread(block, 1, IO_BLOCK, input_file)) > 0) {
+        for (size_t i = 0; i < got; i++) {
+            freq[block[i]]++;
+        }
+        original_file_size += got;
     }
     rewind(input_file);
 
@@ -88,6 +115,8 @@ void encodeFile(const char* input_path, const char* output_path) {
     char current_code[MAX_CHARS];
     for(int i = 0; i < MAX_CHARS; ++i) codes[i] = NULL;
     storeCodes(root, codes, current_code, 0);
+    Code packed[MAX_CHARS];
+    packCodes(codes, packed);
 
     // 3. Write header and compressed data to the output file
     FILE* output_file = fopen(output_path, "wb");
@@ -101,32 +130,30 @@ void encodeFile(const char* input_path, const char* output_path) {
     fwrite(freq, sizeof(unsigned), MAX_CHARS, output_file);
 
     // Write body: the compressed bitstream
-    unsigned char buffer = 0;
-    int bit_count = 0;
-    while ((c = fgetc(input_file)) != EOF) {
-        char* code = codes[c];
-        if (code) { // Ensure code exists
-            while (*code) {
-                buffer <<= 1;
-                if (*code == '1') {
-                    buffer |= 1;
-                }
-                bit_count++;
-                if (bit_count == 8) {
-                    fwrite(&buffer, sizeof(unsigned char), 1, output_file);
-                    buffer = 0;
-                    bit_count = 0;
-                }
-                code++;
+    BitWriter* writer = (BitWriter*)malloc(sizeof(BitWriter));
+    if (!writer) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(1);
+    }
+    writer->file = output_file;
+    writer->used = 0;
+    writer->acc = 0;
+    writer->pending = 0;
+    while ((got = fread(block, 1, IO_BLOCK, input_file)) > 0) {
+        for (size_t i = 0; i < got; i++) {
+            if (codes[block[i]]) { // Ensure code exists
+                writeCode(writer, &packed[block[i]], codes[block[i]]);
             }
         }
     }
 
     // Write any remaining bits in the buffer (padding with 0s)
-    if (bit_count > 0) {
-        buffer <<= (8 - bit_count);
-        fwrite(&buffer, sizeof(unsigned char), 1, output_file);
+    if (writer->pending > 0) {
+        writer->block[writer->used++] = (unsigned char)(writer->acc << (8 - writer->pending));
     }
+    flushBlock(writer);
+    free(writer);
+    free(block);
 
     // --- Cleanup ---
     fclose(input_file);
@@ -138,6 +165,50 @@ void encodeFile(const char* input_path, const char* output_path) {
 }
 
 
+// --- Buffered Bit Output ---
+
+// Pack each code string into a bit pattern; longer codes keep len 0 and
+// are written from their string instead
+void packCodes(char* codes[], Code packed[]) {
+    for (int i = 0; i < MAX_CHARS; i++) {
+        packed[i].bits = 0;
+        packed[i].len = 0;
+        if (!codes[i] || strlen(codes[i]) > PACKED_BITS) continue;
+        for (const char* p = codes[i]; *p; p++) {
+            packed[i].bits = (packed[i].bits << 1) | (*p == '1');
+        }
+        packed[i].len = (int)strlen(codes[i]);
+    }
+}
+
+void flushBlock(BitWriter* writer) {
+    if (writer->used > 0) {
+        fwrite(writer->block, 1, writer->used, writer->file);
+        writer->used = 0;
+    }
+}
+
+// Append one code, moving whole bytes from the accumulator to the block
+void writeCode(BitWriter* writer, const Code* code, const char* text) {
+    if (code->len == 0) {
+        // Too long to pack: one bit at a time
+        for (; *text; text++) {
+            Code bit = { (unsigned long long)(*text == '1'), 1 };
+            writeCode(writer, &bit, NULL);
+        }
+        return;
+    }
+
+    writer->acc = (writer->acc << code->len) | code->bits;
+    writer->pending += code->len;
+    while (writer->pending >= 8) {
+        writer->pending -= 8;
+        writer->block[writer->used++] = (unsigned char)(writer->acc >> writer->pending);
+        if (writer->used == IO_BLOCK) flushBlock(writer);
+    }
+}
+
+
 // --- Helper and Utility Functions ---
 
 Node* newNode(char data, unsigned freq) {
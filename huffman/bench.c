@@ -0,0 +1,649 @@
+/* bench.c - Per-Stage Huffman Throughput Benchmark */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define HUFF_IMPLEMENTATION
+#define CORPUS_IMPLEMENTATION
+#define PERFCOUNT_IMPLEMENTATION
+#include "huff.h"
+#include "corpus.h"
+#include "perfcount.h"
+
+#define MAX_RUNS 1000
+#define SYNTHETIC_SIZE (4 << 20)
+
+#ifndef BENCH_GIT_COMMIT
+#define BENCH_GIT_COMMIT "unknown"
+#endif
+
+#if defined(__clang__)
+#define BENCH_COMPILER "clang " __clang_version__
+#elif defined(__GNUC__)
+#define BENCH_COMPILER "gcc " __VERSION__
+#else
+#define BENCH_COMPILER "unknown"
+#endif
+
+/* Regression gates for --compare: the one-sided Mann-Whitney z score must
+ * exceed BENCH_Z_CRITICAL (p < 0.01) and the median must move by more than
+ * the noise threshold and BENCH_MIN_DELTA_NS, which hides timer jitter on
+ * microsecond stages like tree and codes. */
+#define BENCH_Z_CRITICAL 2.326
+#define BENCH_MIN_DELTA_NS 20000.0
+
+/* Generated corpora: every distribution the tree builder and decoder scale with */
+static const struct {
+    const char *name;
+    CorpusKind kind;
+    double skew;
+    uint64_t size;      /* 0 uses --size */
+} synthetic_corpora[] = {
+    { "uniform",    CORPUS_UNIFORM,    0,    0 },
+    { "single",     CORPUS_SINGLE,     0,    0 },
+    { "geometric",  CORPUS_GEOMETRIC,  0.3,  0 },
+    { "zipf",       CORPUS_ZIPF,       1.0,  0 },
+    { "zipf-flat",  CORPUS_ZIPF,       0.5,  0 },
+    { "sparse",     CORPUS_SPARSE,     0.05, 0 },
+    { "compressed", CORPUS_COMPRESSED, 1.0,  0 },
+    { "fibonacci",  CORPUS_FIBONACCI,  0,    0 },
+    { "small-64",   CORPUS_ZIPF,       1.0,  64 },
+    { "small-4k",   CORPUS_ZIPF,       1.0,  4096 },
+};
+
+enum {
+    STAGE_READ,
+    STAGE_HISTOGRAM,
+    STAGE_TREE,
+    STAGE_CODES,
+    STAGE_ENCODE,
+    STAGE_CRC,
+    STAGE_DECODE,
+    STAGE_WRITE,
+    STAGE_COUNT
+};
+
+static const char *stage_names[STAGE_COUNT] = {
+    "read", "histogram", "tree", "codes", "encode", "crc", "decode", "write"
+};
+
+/* One sample per stage per timed run */
+typedef struct {
+    double ns[STAGE_COUNT][MAX_RUNS];
+    uint64_t cycles[STAGE_COUNT][MAX_RUNS];
+    uint64_t counters[STAGE_COUNT][PERF_MAX_COUNTERS][MAX_RUNS];
+    int runs;
+} Samples;
+
+/* Hardware counters, opened by --perf */
+static PerfCounters perf;
+static int perf_enabled = 0;
+
+/* Baseline recording (--save) and comparison (--compare) */
+static FILE *save_fp = NULL;
+static int save_first = 1;
+static char *baseline = NULL;
+static double threshold_pct = 5.0;
+static int regressions = 0;
+
+static uint64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint64_t nowCycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static int cmpDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Percentile of n samples (p in 0..100), sorts a copy */
+static double percentile(const double *samples, int n, double p) {
+    double sorted[MAX_RUNS];
+    memcpy(sorted, samples, n * sizeof(double));
+    qsort(sorted, n, sizeof(double), cmpDouble);
+
+    int idx = (int)(p / 100.0 * (n - 1) + 0.5);
+    return sorted[idx];
+}
+
+/* Write a generated corpus to a temporary file, returns its path */
+static char *makeSynthetic(const CorpusSpec *spec, uint64_t size) {
+    char *path = malloc(64);
+    snprintf(path, 64, "/tmp/huffbench-%s-XXXXXX", corpusKindName(spec->kind));
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("Error creating synthetic corpus");
+        free(path);
+        return NULL;
+    }
+
+    FILE *fp = fdopen(fd, "wb");
+    int ok = corpusWrite(fp, spec, size);
+    fclose(fp);
+    if (!ok) {
+        fprintf(stderr, "Error: Could not generate %s corpus\n", corpusKindName(spec->kind));
+        remove(path);
+        free(path);
+        return NULL;
+    }
+    return path;
+}
+
+/* Run the full pipeline once, recording each stage. Returns 0 on failure. */
+static int runOnce(const char *path, Samples *s, int record, size_t *in_size, size_t *out_size,
+                   int *table_bits) {
+    uint64_t t0, c0;
+    uint64_t p0[PERF_MAX_COUNTERS], p1[PERF_MAX_COUNTERS];
+    int r = s->runs;
+
+#define STAGE_BEGIN() do { \
+        if (perf_enabled) perfRead(&perf, p0); \
+        t0 = nowNs(); \
+        c0 = nowCycles(); \
+    } while (0)
+#define STAGE_END(st) do { \
+        if (record) { \
+            s->ns[st][r] = (double)(nowNs() - t0); \
+            s->cycles[st][r] = nowCycles() - c0; \
+            if (perf_enabled) { \
+                perfRead(&perf, p1); \
+                for (int pc = 0; pc < PERF_MAX_COUNTERS; pc++) { \
+                    s->counters[st][pc][r] = p1[pc] - p0[pc]; \
+                } \
+            } \
+        } \
+    } while (0)
+
+    /* Read */
+    STAGE_BEGIN();
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        perror("Error opening corpus");
+        return 0;
+    }
+    fseek(fp, 0, SEEK_END);
+    long len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (len <= 0) {
+        fprintf(stderr, "Error: Corpus '%s' is empty\n", path);
+        fclose(fp);
+        return 0;
+    }
+    uint8_t *data = memAlloc(len);
+    if (!data || fread(data, 1, len, fp) != (size_t)len) {
+        fprintf(stderr, "Error: Could not read corpus '%s'\n", path);
+        memFree(data);
+        fclose(fp);
+        return 0;
+    }
+    fclose(fp);
+    STAGE_END(STAGE_READ);
+
+    /* Histogram */
+    uint32_t freq[MAXN];
+    STAGE_BEGIN();
+    buildFreqTable(data, len, freq);
+    STAGE_END(STAGE_HISTOGRAM);
+
+    /* Tree build */
+    STAGE_BEGIN();
+    Node *root = buildHuffmanTree(freq);
+    STAGE_END(STAGE_TREE);
+
+    /* Code generation */
+    CodeEntry codes[MAXN];
+    STAGE_BEGIN();
+    buildCodes(root, codes);
+    STAGE_END(STAGE_CODES);
+
+    /* Encode */
+    STAGE_BEGIN();
+    BitBuffer *compressed = compress(data, len, codes);
+    STAGE_END(STAGE_ENCODE);
+    if (!compressed) {
+        freeCodes(codes);
+        freeTree(root);
+        memFree(data);
+        return 0;
+    }
+
+    /* CRC */
+    STAGE_BEGIN();
+    volatile uint32_t checksum = crc32(data, len);
+    (void)checksum;
+    STAGE_END(STAGE_CRC);
+
+    /* Decode (from one contiguous block, gathered untimed) */
+    uint64_t compressed_size = bitBufferLength(compressed);
+    uint8_t *stream = bitBufferCoalesce(compressed);
+    STAGE_BEGIN();
+    BitReader *reader = stream ? bitReaderInit(stream, compressed_size) : NULL;
+    uint8_t padding = compressed->bits_used > 0 ? (8 - compressed->bits_used) : 0;
+    uint8_t *decoded = decompress(reader, root, len, padding);
+    STAGE_END(STAGE_DECODE);
+
+    int ok = decoded && memcmp(decoded, data, len) == 0;
+    if (!ok) fprintf(stderr, "Error: Round trip mismatch on '%s'\n", path);
+
+    /* Write */
+    STAGE_BEGIN();
+    FILE *out = tmpfile();
+    if (out) {
+        bitBufferWrite(compressed, out, 0, NULL);
+        fclose(out);
+    }
+    STAGE_END(STAGE_WRITE);
+
+#undef STAGE_BEGIN
+#undef STAGE_END
+
+    *in_size = len;
+    *table_bits = decodeTableBits(root, len);
+    *out_size = compressed_size + sizeof(HuffHeader);
+    for (int i = 0; i < MAXN; i++) {
+        if (freq[i] > 0) *out_size += sizeof(FreqEntry);
+    }
+
+    memFree(reader);
+    memFree(decoded);
+    bitBufferFree(compressed);
+    freeCodes(codes);
+    freeTree(root);
+    memFree(data);
+    return ok;
+}
+
+/* Median hardware counters per stage, normalized to the input size */
+static void printCounters(const Samples *s, size_t in_size) {
+    printf("  %-10s %8s", "counters", "IPC");
+    for (int c = 0; c < PERF_MAX_COUNTERS; c++) {
+        if (perfAvailable(&perf, c)) printf(" %16s", perfCounterName(c));
+    }
+    printf("   (per KiB input)\n");
+
+    for (int st = 0; st < STAGE_COUNT; st++) {
+        double med[PERF_MAX_COUNTERS];
+        for (int c = 0; c < PERF_MAX_COUNTERS; c++) {
+            double v[MAX_RUNS];
+            for (int i = 0; i < s->runs; i++) v[i] = (double)s->counters[st][c][i];
+            med[c] = percentile(v, s->runs, 50);
+        }
+
+        printf("  %-10s %8.2f", stage_names[st],
+               med[PERF_CYCLES] > 0 ? med[PERF_INSTRUCTIONS] / med[PERF_CYCLES] : 0.0);
+        for (int c = 0; c < PERF_MAX_COUNTERS; c++) {
+            if (perfAvailable(&perf, c)) printf(" %16.2f", med[c] * 1024.0 / in_size);
+        }
+        printf("\n");
+    }
+}
+
+/* CPU model from /proc/cpuinfo, used to key baselines */
+static void cpuModel(char *out, size_t cap) {
+    snprintf(out, cap, "unknown");
+    FILE *fp = fopen("/proc/cpuinfo", "r");
+    if (!fp) return;
+
+    char line[512];
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "model name", 10) == 0) {
+            char *colon = strchr(line, ':');
+            if (colon) {
+                colon += 2;
+                colon[strcspn(colon, "\n")] = '\0';
+                snprintf(out, cap, "%s", colon);
+            }
+            break;
+        }
+    }
+    fclose(fp);
+}
+
+/* Read a whole file into a NUL-terminated buffer */
+static char *slurp(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+
+    fseek(fp, 0, SEEK_END);
+    long len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char *text = malloc(len + 1);
+    if (text && fread(text, 1, len, fp) == (size_t)len) {
+        text[len] = '\0';
+    } else {
+        free(text);
+        text = NULL;
+    }
+    fclose(fp);
+    return text;
+}
+
+/* Copy a top-level string field out of the baseline JSON */
+static void baselineField(const char *text, const char *key, char *out, size_t cap) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\":\"", key);
+    const char *p = strstr(text, pattern);
+    snprintf(out, cap, "unknown");
+    if (!p) return;
+
+    p += strlen(pattern);
+    size_t n = strcspn(p, "\"");
+    if (n >= cap) n = cap - 1;
+    memcpy(out, p, n);
+    out[n] = '\0';
+}
+
+/* Samples of one stage for one corpus from a baseline written by --save.
+ * Each corpus sits on its own line, so the search stays within that line. */
+static int baselineSamples(const char *text, const char *corpus, const char *stage, double *out) {
+    char pattern[512];
+    snprintf(pattern, sizeof(pattern), "{\"name\":\"%s\",", corpus);
+    const char *line = strstr(text, pattern);
+    if (!line) return 0;
+    const char *eol = strchr(line, '\n');
+
+    snprintf(pattern, sizeof(pattern), "\"%s\":[", stage);
+    const char *p = strstr(line, pattern);
+    if (!p || (eol && p > eol)) return 0;
+    p += strlen(pattern);
+
+    int n = 0;
+    while (*p && *p != ']' && n < MAX_RUNS) {
+        char *end;
+        out[n++] = strtod(p, &end);
+        if (end == p) break;
+        p = end;
+        if (*p == ',') p++;
+    }
+    return n;
+}
+
+static void saveHeader(FILE *fp, int warmup, int runs) {
+    char cpu[256];
+    cpuModel(cpu, sizeof(cpu));
+    fprintf(fp, "{\"commit\":\"%s\",\"cpu\":\"%s\",\"compiler\":\"%s\","
+            "\"warmup\":%d,\"runs\":%d,\"corpora\":[\n",
+            BENCH_GIT_COMMIT, cpu, BENCH_COMPILER, warmup, runs);
+}
+
+static void saveCorpus(FILE *fp, const char *name, size_t in_size, size_t out_size, const Samples *s) {
+    fprintf(fp, "%s{\"name\":\"%s\",\"bytes\":%zu,\"compressed\":%zu,\"stages_ns\":{",
+            save_first ? "" : ",\n", name, in_size, out_size);
+    for (int st = 0; st < STAGE_COUNT; st++) {
+        fprintf(fp, "%s\"%s\":[", st ? "," : "", stage_names[st]);
+        for (int i = 0; i < s->runs; i++) {
+            fprintf(fp, "%s%.0f", i ? "," : "", s->ns[st][i]);
+        }
+        fprintf(fp, "]");
+    }
+    fprintf(fp, "}}");
+    save_first = 0;
+}
+
+/* One-sided Mann-Whitney U test: z > 0 means current tends to be slower */
+static double mannWhitneyZ(const double *base, int nb, const double *cur, int nc) {
+    double u = 0;
+    for (int i = 0; i < nc; i++) {
+        for (int j = 0; j < nb; j++) {
+            if (cur[i] > base[j]) u += 1.0;
+            else if (cur[i] == base[j]) u += 0.5;
+        }
+    }
+    double mean = nb * (double)nc / 2.0;
+    double sd = sqrt(nb * (double)nc * (nb + nc + 1) / 12.0);
+    return sd > 0 ? (u - mean) / sd : 0.0;
+}
+
+static void compareCorpus(const char *name, const Samples *s) {
+    double base[MAX_RUNS];
+
+    printf("  %-10s %12s %12s %9s %8s  %s\n",
+           "vs base", "base ms", "now ms", "delta", "z", "verdict");
+    for (int st = 0; st < STAGE_COUNT; st++) {
+        int nb = baselineSamples(baseline, name, stage_names[st], base);
+        if (nb == 0) {
+            printf("  %-10s %12s\n", stage_names[st], "(no baseline)");
+            continue;
+        }
+
+        double bmed = percentile(base, nb, 50);
+        double cmed = percentile(s->ns[st], s->runs, 50);
+        double delta = bmed > 0 ? 100.0 * (cmed - bmed) / bmed : 0.0;
+        double z = mannWhitneyZ(base, nb, s->ns[st], s->runs);
+        int significant = fabs(cmed - bmed) > BENCH_MIN_DELTA_NS && fabs(delta) > threshold_pct;
+
+        const char *verdict = "~";
+        if (significant && z > BENCH_Z_CRITICAL) {
+            verdict = "REGRESSION";
+            regressions++;
+        } else if (significant && z < -BENCH_Z_CRITICAL) {
+            verdict = "improved";
+        }
+
+        printf("  %-10s %12.3f %12.3f %+8.1f%% %8.2f  %s\n",
+               stage_names[st], bmed / 1e6, cmed / 1e6, delta, z, verdict);
+    }
+}
+
+static int benchCorpus(const char *name, const char *path, int warmup, int runs) {
+    static Samples s;
+    size_t in_size = 0, out_size = 0;
+    int table_bits = 0;
+
+    s.runs = 0;
+    for (int i = 0; i < warmup; i++) {
+        if (!runOnce(path, &s, 0, &in_size, &out_size, &table_bits)) return 0;
+    }
+    for (int i = 0; i < runs; i++) {
+        if (!runOnce(path, &s, 1, &in_size, &out_size, &table_bits)) return 0;
+        s.runs++;
+    }
+
+    printf("\n%s: %zu bytes -> %zu bytes (ratio %.4f, %.3f bits/byte, %d-bit decode table)\n",
+           name, in_size, out_size, (double)out_size / in_size,
+           8.0 * out_size / in_size, table_bits);
+    printf("  %-10s %12s %12s %12s %12s\n",
+           "stage", "median ms", "p95 ms", "MB/s", "cycles/B");
+
+    double total = 0;
+    for (int st = 0; st < STAGE_COUNT; st++) {
+        double med = percentile(s.ns[st], s.runs, 50);
+        double p95 = percentile(s.ns[st], s.runs, 95);
+
+        double cyc[MAX_RUNS];
+        for (int i = 0; i < s.runs; i++) cyc[i] = (double)s.cycles[st][i];
+        double med_cyc = percentile(cyc, s.runs, 50);
+
+        printf("  %-10s %12.3f %12.3f %12.1f %12.3f\n",
+               stage_names[st], med / 1e6, p95 / 1e6,
+               med > 0 ? in_size / (med / 1e9) / 1e6 : 0.0,
+               med_cyc / in_size);
+        total += med;
+    }
+    printf("  %-10s %12.3f %12s %12.1f\n", "total", total / 1e6, "",
+           in_size / (total / 1e9) / 1e6);
+
+    if (perf_enabled) printCounters(&s, in_size);
+    if (save_fp) saveCorpus(save_fp, name, in_size, out_size, &s);
+    if (baseline) compareCorpus(name, &s);
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    int warmup = 2;
+    int runs = 10;
+    int synthetic = 1;
+    uint64_t synthetic_size = SYNTHETIC_SIZE;
+    const char *files[64];
+    int nfiles = 0;
+    const char *save_path = NULL;
+    const char *compare_path = NULL;
+    MemHugeMode huge_pages = MEM_HUGE_OFF;
+
+    /* Parse command line arguments */
+    for (int i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "-n") == 0 || strcmp(argv[i], "--runs") == 0) && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        } else if ((strcmp(argv[i], "-w") == 0 || strcmp(argv[i], "--warmup") == 0) && i + 1 < argc) {
+            warmup = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            if (!memParseSize(argv[++i], &synthetic_size) || synthetic_size == 0) {
+                fprintf(stderr, "Error: Invalid size '%s'\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--table-bits") == 0 && i + 1 < argc) {
+            int bits = atoi(argv[++i]);
+            if (bits < HUFF_TABLE_BITS_MIN || bits > HUFF_TABLE_BITS_MAX) {
+                fprintf(stderr, "Error: --table-bits must be between %d and %d\n",
+                        HUFF_TABLE_BITS_MIN, HUFF_TABLE_BITS_MAX);
+                return 1;
+            }
+            setTableBits(bits);
+        } else if (strcmp(argv[i], "--huge-pages") == 0 && i + 1 < argc) {
+            if (!memParseHugePages(argv[++i], &huge_pages)) {
+                fprintf(stderr, "Error: --huge-pages must be off, thp or explicit\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--stores") == 0 && i + 1 < argc) {
+            HuffStoreMode mode;
+            if (!parseOutputStores(argv[++i], &mode)) {
+                fprintf(stderr, "Error: --stores must be auto, cached or streaming\n");
+                return 1;
+            }
+            setOutputStores(mode);
+        } else if (strcmp(argv[i], "--perf") == 0) {
+            perf_enabled = 1;
+        } else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc) {
+            save_path = argv[++i];
+        } else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc) {
+            compare_path = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold_pct = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--no-synthetic") == 0) {
+            synthetic = 0;
+        } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            printf("Usage: %s [options] [file...]\n", argv[0]);
+            printf("Options:\n");
+            printf("  -n, --runs N       Timed runs per corpus (default 10)\n");
+            printf("  -w, --warmup N     Untimed warmup runs (default 2)\n");
+            printf("  --size N           Generated corpus size (default 4M)\n");
+            printf("  --no-synthetic     Skip the generated corpora\n");
+            printf("  --perf             Report hardware counters per stage\n");
+            printf("  --table-bits N     Pin the decode table width (default: tuned)\n");
+            printf("  --huge-pages MODE  Back large buffers with huge pages: off, thp, explicit\n");
+            printf("  --stores MODE      Decode output stores: auto, cached, streaming\n");
+            printf("  --save FILE        Record samples as a baseline (JSON)\n");
+            printf("  --compare FILE     Flag significant regressions against a baseline\n");
+            printf("  --threshold PCT    Noise threshold for --compare (default 5)\n");
+            printf("  -h, --help         Show this help\n");
+            printf("With no files, kjv.csv is benchmarked.\n");
+            return 0;
+        } else if (nfiles < 64) {
+            files[nfiles++] = argv[i];
+        }
+    }
+
+    if (runs < 1 || runs > MAX_RUNS) {
+        fprintf(stderr, "Error: --runs must be between 1 and %d\n", MAX_RUNS);
+        return 1;
+    }
+    if (warmup < 0) warmup = 0;
+    if (nfiles == 0) files[nfiles++] = "kjv.csv";
+
+    if (perf_enabled && perfOpen(&perf) == 0) {
+        fprintf(stderr, "Warning: Hardware performance counters unavailable\n");
+        perf_enabled = 0;
+    }
+
+    if (compare_path) {
+        baseline = slurp(compare_path);
+        if (!baseline) {
+            fprintf(stderr, "Error: Cannot read baseline '%s'\n", compare_path);
+            return 1;
+        }
+
+        char cpu[256], base_cpu[256], base_compiler[256], base_commit[64];
+        cpuModel(cpu, sizeof(cpu));
+        baselineField(baseline, "cpu", base_cpu, sizeof(base_cpu));
+        baselineField(baseline, "compiler", base_compiler, sizeof(base_compiler));
+        baselineField(baseline, "commit", base_commit, sizeof(base_commit));
+        printf("Baseline: commit %s, %s, %s\n", base_commit, base_cpu, base_compiler);
+        if (strcmp(cpu, base_cpu) != 0 || strcmp(BENCH_COMPILER, base_compiler) != 0) {
+            fprintf(stderr, "Warning: Baseline was recorded on a different CPU or compiler\n");
+        }
+    }
+
+    if (save_path) {
+        save_fp = fopen(save_path, "w");
+        if (!save_fp) {
+            perror("Error opening baseline file");
+            return 1;
+        }
+        saveHeader(save_fp, warmup, runs);
+    }
+
+    init_crc32();
+    memSetHugePages(huge_pages);
+
+    printf("Huffman stage benchmark: commit %s, %s\n", BENCH_GIT_COMMIT, BENCH_COMPILER);
+    printf("Kernels: %s (override with HUFF_CPU)\n", huffKernels()->name);
+    printf("%d warmup, %d timed runs, median/p95\n", warmup, runs);
+    if (huge_pages != MEM_HUGE_OFF) {
+        printf("Huge pages: %s\n", huge_pages == MEM_HUGE_THP ? "thp" : "explicit, thp fallback");
+    }
+
+    int ok = 1;
+    for (int i = 0; i < nfiles; i++) {
+        ok &= benchCorpus(files[i], files[i], warmup, runs);
+    }
+
+    if (synthetic) {
+        int count = sizeof(synthetic_corpora) / sizeof(synthetic_corpora[0]);
+        for (int i = 0; i < count; i++) {
+            CorpusSpec spec = {
+                .kind = synthetic_corpora[i].kind,
+                .seed = 1,
+                .skew = synthetic_corpora[i].skew
+            };
+            uint64_t size = synthetic_corpora[i].size ? synthetic_corpora[i].size : synthetic_size;
+            char *path = makeSynthetic(&spec, size);
+            if (!path) {
+                ok = 0;
+                continue;
+            }
+            ok &= benchCorpus(synthetic_corpora[i].name, path, warmup, runs);
+            remove(path);
+            free(path);
+        }
+    }
+
+    if (save_fp) {
+        fprintf(save_fp, "\n]}\n");
+        fclose(save_fp);
+    }
+
+    if (baseline) {
+        printf("\n%d significant regression%s against '%s'\n",
+               regressions, regressions == 1 ? "" : "s", compare_path);
+        free(baseline);
+        if (regressions > 0) return 2;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,272 @@
+/* corpus.h - Single Header Synthetic Corpus Generator
+ *
+ * Reproducible (seeded) inputs covering the distribution space Huffman
+ * coding cares about: flat, degenerate, skewed, sparse, incompressible and
+ * maximally deep trees. Output is streamed in fixed-size chunks, so sizes
+ * far beyond RAM are fine.
+ *
+ * Usage:
+ *   #define CORPUS_IMPLEMENTATION
+ *   #include "corpus.h"
+ *
+ * The "compressed" kind uses the kernels from huff.h, so the including
+ * translation unit must also provide HUFF_IMPLEMENTATION.
+ */
+
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "huff.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    CORPUS_UNIFORM,     /* Uniform random bytes, 256 active symbols */
+    CORPUS_SINGLE,      /* One repeated symbol */
+    CORPUS_GEOMETRIC,   /* P(k) ~ (1 - skew)^k */
+    CORPUS_ZIPF,        /* P(k) ~ 1 / (k + 1)^skew */
+    CORPUS_SPARSE,      /* Binary data, each bit set with probability skew */
+    CORPUS_COMPRESSED,  /* Huffman-coded Zipf text, near-incompressible */
+    CORPUS_FIBONACCI,   /* Fibonacci frequencies, deepest possible tree */
+    CORPUS_KIND_COUNT
+} CorpusKind;
+
+typedef struct {
+    CorpusKind kind;
+    uint64_t seed;
+    double skew;        /* <= 0 selects the kind's default */
+} CorpusSpec;
+
+/* Corpus Interface */
+int corpusParseKind(const char *name, CorpusKind *kind);
+const char *corpusKindName(CorpusKind kind);
+int corpusWrite(FILE *fp, const CorpusSpec *spec, uint64_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* ============================================================================
+ * IMPLEMENTATION
+ * ============================================================================ */
+
+#ifdef CORPUS_IMPLEMENTATION
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define CORPUS_CHUNK (1 << 20)
+
+static const char *corpus_names[CORPUS_KIND_COUNT] = {
+    "uniform", "single", "geometric", "zipf", "sparse", "compressed", "fibonacci"
+};
+
+int corpusParseKind(const char *name, CorpusKind *kind) {
+    for (int i = 0; i < CORPUS_KIND_COUNT; i++) {
+        if (strcmp(name, corpus_names[i]) == 0) {
+            *kind = (CorpusKind)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+const char *corpusKindName(CorpusKind kind) {
+    return kind < CORPUS_KIND_COUNT ? corpus_names[kind] : "unknown";
+}
+
+/* SplitMix64 - tiny, seedable and good enough for test data */
+static uint64_t corpusRand(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+/* Cumulative distribution over 256 symbols, scaled to 2^32 */
+typedef struct {
+    uint64_t cdf[MAXN];
+} CorpusTable;
+
+static void corpusBuildTable(CorpusTable *t, const double weight[]) {
+    double total = 0;
+    for (int i = 0; i < MAXN; i++) total += weight[i];
+
+    double acc = 0;
+    for (int i = 0; i < MAXN; i++) {
+        acc += weight[i];
+        t->cdf[i] = (uint64_t)(acc / total * 4294967296.0);
+    }
+    t->cdf[MAXN - 1] = 4294967296ull;
+}
+
+static uint8_t corpusSample(const CorpusTable *t, uint64_t *state) {
+    uint64_t r = corpusRand(state) >> 32;
+    int lo = 0, hi = MAXN - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (r < t->cdf[mid]) hi = mid;
+        else lo = mid + 1;
+    }
+    return (uint8_t)lo;
+}
+
+static void corpusZipfTable(CorpusTable *t, double s) {
+    double weight[MAXN];
+    for (int i = 0; i < MAXN; i++) weight[i] = 1.0 / pow(i + 1, s);
+    corpusBuildTable(t, weight);
+}
+
+/* Fill buf with n bytes of a Zipf stream (used raw and as compressor input) */
+static void corpusFillTable(uint8_t *buf, size_t n, const CorpusTable *t, uint64_t *state) {
+    for (size_t i = 0; i < n; i++) buf[i] = corpusSample(t, state);
+}
+
+/* Huffman-code a chunk of Zipf text; returns bytes placed in out */
+static size_t corpusCompressChunk(uint8_t *out, size_t cap, const CorpusTable *t, uint64_t *state) {
+    uint8_t *text = malloc(cap);
+    if (!text) return 0;
+    corpusFillTable(text, cap, t, state);
+
+    uint32_t freq[MAXN];
+    CodeEntry codes[MAXN];
+    buildFreqTable(text, cap, freq);
+    Node *root = buildHuffmanTree(freq);
+    buildCodes(root, codes);
+    BitBuffer *bits = compress(text, cap, codes);
+
+    size_t n = 0;
+    if (bits) {
+        uint64_t len = bitBufferLength(bits);
+        uint8_t *stream = bitBufferCoalesce(bits);
+        n = stream ? (len < cap ? len : cap) : 0;
+        if (n) memcpy(out, stream, n);
+        bitBufferFree(bits);
+    }
+    freeCodes(codes);
+    freeTree(root);
+    free(text);
+    return n;
+}
+
+int corpusWrite(FILE *fp, const CorpusSpec *spec, uint64_t size) {
+    uint8_t *chunk = malloc(CORPUS_CHUNK);
+    if (!chunk) return 0;
+
+    uint64_t state = spec->seed;
+    CorpusTable table;
+    double skew = spec->skew;
+
+    switch (spec->kind) {
+    case CORPUS_GEOMETRIC: {
+        if (skew <= 0 || skew >= 1) skew = 0.3;
+        double weight[MAXN];
+        for (int i = 0; i < MAXN; i++) weight[i] = pow(1.0 - skew, i);
+        corpusBuildTable(&table, weight);
+        break;
+    }
+    case CORPUS_ZIPF:
+    case CORPUS_COMPRESSED:
+        corpusZipfTable(&table, skew > 0 ? skew : 1.0);
+        break;
+    case CORPUS_SPARSE:
+        if (skew <= 0 || skew >= 1) skew = 0.05;
+        break;
+    default:
+        break;
+    }
+
+    /* Fibonacci: symbol k repeated fib(k) times per period. The largest
+     * prefix whose period fits in the output gives the deepest tree. */
+    uint64_t fib[MAXN];
+    int fib_symbols = 1;
+    uint64_t fib_period = 1, fib_pos = 0;
+    int fib_sym = 0;
+    if (spec->kind == CORPUS_FIBONACCI) {
+        fib[0] = 1;
+        fib[1] = 1;
+        fib_period = 1;
+        while (fib_symbols < MAXN) {
+            uint64_t next = fib_symbols < 2 ? 1 : fib[fib_symbols - 1] + fib[fib_symbols - 2];
+            if (next > UINT32_MAX || fib_period + next > size) break;
+            fib[fib_symbols++] = next;
+            fib_period += next;
+        }
+    }
+
+    uint64_t remaining = size;
+    while (remaining > 0) {
+        size_t n = remaining < CORPUS_CHUNK ? (size_t)remaining : CORPUS_CHUNK;
+
+        switch (spec->kind) {
+        case CORPUS_UNIFORM:
+            for (size_t i = 0; i < n; i += 8) {
+                uint64_t r = corpusRand(&state);
+                size_t m = n - i < 8 ? n - i : 8;
+                memcpy(chunk + i, &r, m);
+            }
+            break;
+        case CORPUS_SINGLE:
+            memset(chunk, 'A' + (int)(spec->seed % 26), n);
+            break;
+        case CORPUS_GEOMETRIC:
+        case CORPUS_ZIPF:
+            corpusFillTable(chunk, n, &table, &state);
+            break;
+        case CORPUS_SPARSE:
+            for (size_t i = 0; i < n; i++) {
+                uint8_t byte = 0;
+                for (int b = 0; b < 8; b++) {
+                    double u = (corpusRand(&state) >> 11) * (1.0 / 9007199254740992.0);
+                    byte = (byte << 1) | (u < skew);
+                }
+                chunk[i] = byte;
+            }
+            break;
+        case CORPUS_COMPRESSED: {
+            size_t filled = 0;
+            while (filled < n) {
+                size_t got = corpusCompressChunk(chunk + filled, n - filled, &table, &state);
+                if (got == 0) break;
+                filled += got;
+            }
+            if (filled < n) {
+                free(chunk);
+                return 0;
+            }
+            break;
+        }
+        case CORPUS_FIBONACCI:
+            for (size_t i = 0; i < n; i++) {
+                chunk[i] = (uint8_t)fib_sym;
+                if (++fib_pos == fib[fib_sym]) {
+                    fib_pos = 0;
+                    fib_sym = (fib_sym + 1) % fib_symbols;
+                }
+            }
+            break;
+        default:
+            free(chunk);
+            return 0;
+        }
+
+        if (fwrite(chunk, 1, n, fp) != n) {
+            free(chunk);
+            return 0;
+        }
+        remaining -= n;
+    }
+
+    free(chunk);
+    return 1;
+}
+
+#endif /* CORPUS_IMPLEMENTATION */
+
+#endif /* CORPUS_H */
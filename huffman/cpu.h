@@ -0,0 +1,195 @@
+/* cpu.h - Single Header CPU Feature Detection
+ *
+ * Probes CPUID (and XGETBV for OS-enabled vector state) once and reduces
+ * the result to an ordered dispatch level. HUFF_CPU=generic|sse42|avx2|avx512
+ * caps the level so every kernel path can be exercised on one host.
+ *
+ * Usage:
+ *   #define CPU_IMPLEMENTATION
+ *   #include "cpu.h"
+ */
+
+#ifndef CPU_H
+#define CPU_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    CPU_GENERIC,    /* Portable C */
+    CPU_SSE42,      /* SSE4.2 + PCLMULQDQ */
+    CPU_AVX2,       /* AVX2 + BMI1/BMI2 + LZCNT */
+    CPU_AVX512,     /* AVX-512F/BW */
+    CPU_LEVEL_COUNT
+} CpuLevel;
+
+/* CPU Interface */
+CpuLevel cpuDetect(void);
+CpuLevel cpuLevel(void);
+const char *cpuLevelName(CpuLevel level);
+size_t cpuL1DataCacheSize(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* ============================================================================
+ * IMPLEMENTATION
+ * ============================================================================ */
+
+#ifdef CPU_IMPLEMENTATION
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+static const char *cpu_level_names[CPU_LEVEL_COUNT] = {
+    "generic", "sse42", "avx2", "avx512"
+};
+
+const char *cpuLevelName(CpuLevel level) {
+    return level < CPU_LEVEL_COUNT ? cpu_level_names[level] : "unknown";
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+static unsigned long long cpuXgetbv(void) {
+    unsigned int lo, hi;
+    __asm__ volatile ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((unsigned long long)hi << 32) | lo;
+}
+#endif
+
+/* Highest level the hardware and OS support */
+CpuLevel cpuDetect(void) {
+    CpuLevel level = CPU_GENERIC;
+
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return level;
+
+    int sse42 = (ecx >> 20) & 1;
+    int pclmul = (ecx >> 1) & 1;
+    int osxsave = (ecx >> 27) & 1;
+    if (!sse42 || !pclmul) return level;
+    level = CPU_SSE42;
+
+    /* YMM (and for AVX-512, opmask/ZMM) state must be enabled by the OS */
+    if (!osxsave) return level;
+    unsigned long long xcr0 = cpuXgetbv();
+    if ((xcr0 & 0x6) != 0x6) return level;
+
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return level;
+    int bmi1 = (ebx >> 3) & 1;
+    int avx2 = (ebx >> 5) & 1;
+    int bmi2 = (ebx >> 8) & 1;
+    int avx512f = (ebx >> 16) & 1;
+    int avx512bw = (ebx >> 30) & 1;
+
+    /* The AVX2-level kernels are built with target("bmi,bmi2,lzcnt") */
+    unsigned int ext_eax, ext_ebx, ext_ecx = 0, ext_edx;
+    int lzcnt = __get_cpuid(0x80000001, &ext_eax, &ext_ebx, &ext_ecx, &ext_edx) &&
+                ((ext_ecx >> 5) & 1);
+    if (!avx2 || !bmi1 || !bmi2 || !lzcnt) return level;
+    level = CPU_AVX2;
+
+    if (avx512f && avx512bw && (xcr0 & 0xE0) == 0xE0) level = CPU_AVX512;
+#endif
+
+    return level;
+}
+
+/* Detected level, capped by HUFF_CPU. Computed once. */
+CpuLevel cpuLevel(void) {
+    static int cached = -1;
+    if (cached >= 0) return (CpuLevel)cached;
+
+    CpuLevel level = cpuDetect();
+    const char *env = getenv("HUFF_CPU");
+    if (env && *env && strcmp(env, "native") != 0) {
+        int found = 0;
+        for (int i = 0; i < CPU_LEVEL_COUNT; i++) {
+            if (strcmp(env, cpu_level_names[i]) == 0) {
+                found = 1;
+                if ((CpuLevel)i > level) {
+                    fprintf(stderr, "Warning: HUFF_CPU=%s not supported here, using %s\n",
+                            env, cpu_level_names[level]);
+                } else {
+                    level = (CpuLevel)i;
+                }
+                break;
+            }
+        }
+        if (!found) {
+            fprintf(stderr, "Warning: Unknown HUFF_CPU=%s, using %s\n",
+                    env, cpu_level_names[level]);
+        }
+    }
+
+    cached = level;
+    return level;
+}
+
+/* Read "48K"-style sysfs cache attributes; 0 when missing */
+static size_t cpuSysfsSize(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return 0;
+
+    char text[32] = "";
+    size_t size = 0;
+    if (fgets(text, sizeof(text), fp)) {
+        char *end;
+        size = strtoul(text, &end, 10);
+        if (*end == 'K') size <<= 10;
+        else if (*end == 'M') size <<= 20;
+    }
+    fclose(fp);
+    return size;
+}
+
+/* L1 data cache size: sysfs, then sysconf, then a conservative 32 KiB */
+size_t cpuL1DataCacheSize(void) {
+    static size_t cached = 0;
+    if (cached) return cached;
+
+    for (int i = 0; i < 8 && !cached; i++) {
+        char path[128], text[16] = "";
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/level", i);
+        FILE *fp = fopen(path, "r");
+        if (!fp) break;
+        int level = fgets(text, sizeof(text), fp) ? atoi(text) : 0;
+        fclose(fp);
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/type", i);
+        fp = fopen(path, "r");
+        if (!fp) continue;
+        int data = fgets(text, sizeof(text), fp) && strncmp(text, "Instruction", 11) != 0;
+        fclose(fp);
+
+        if (level == 1 && data) {
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", i);
+            cached = cpuSysfsSize(path);
+        }
+    }
+
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+    if (!cached) {
+        long size = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+        if (size > 0) cached = size;
+    }
+#endif
+
+    if (!cached) cached = 32 << 10;
+    return cached;
+}
+
+#endif /* CPU_IMPLEMENTATION */
+
+#endif /* CPU_H */
@@ -3,254 +3,224 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
-#include <sys/stat.h>
-#include <time.h>
 
-#define PQUEUE_IMPLEMENTATION
-#include "pqueue.h"
+#define HUFF_IMPLEMENTATION
+#define STATS_IMPLEMENTATION
+#define PROGRESS_IMPLEMENTATION
+#define LEGACY_IMPLEMENTATION
+#include "huff.h"
+#include "stats.h"
+#include "progress.h"
+#include "legacy.h"
 
-#define MAXN 256
-#define MAGIC_NUMBER 0x48554646  /* "HUFF" */
+#define DECODE_CHUNK (1 << 20)
 
-/* Binary file format structures */
-typedef struct {
-    uint32_t magic;
-    uint16_t version;
-    uint64_t original_size;
-    uint64_t compressed_size;
-    uint32_t checksum;
-    uint16_t tree_size;
-    uint8_t padding_bits;
-    uint8_t reserved;
-} __attribute__((packed)) HuffHeader;
-
-typedef struct {
-    uint8_t ch;
-    uint32_t freq;
-} __attribute__((packed)) FreqEntry;
-
-typedef struct {
-    const uint8_t *data;
-    size_t size;
-    size_t pos;
-    uint8_t bit_buffer;
-    uint8_t bits_available;
-} BitReader;
-
-/* Bit reader for binary decompression */
-static BitReader *bitReaderInit(const uint8_t *data, size_t size) {
-    BitReader *reader = malloc(sizeof(BitReader));
-    if (!reader) return NULL;
-    
-    reader->data = data;
-    reader->size = size;
-    reader->pos = 0;
-    reader->bit_buffer = 0;
-    reader->bits_available = 0;
-    return reader;
+/* Read a v1 header */
+static int readHeader(FILE *fp, HuffHeader *header) {
+    return fread(header, sizeof(HuffHeader), 1, fp) == 1;
 }
 
-static int bitReaderReadBit(BitReader *reader) {
-    if (reader->bits_available == 0) {
-        if (reader->pos >= reader->size) return -1;
-        
-        reader->bit_buffer = reader->data[reader->pos++];
-        reader->bits_available = 8;
+/* Check a v1 header against the file it came from, reporting what is
+ * wrong only when asked to (sniffing tries huffman-00 before giving up) */
+static int headerValid(const HuffHeader *header, uint64_t file_size, int report) {
+    if (header->magic != MAGIC_NUMBER) {
+        if (report) fprintf(stderr, "Error: Not a valid Huffman compressed file\n");
+        return 0;
     }
     
-    int bit = (reader->bit_buffer >> 7) & 1;
-    reader->bit_buffer <<= 1;
-    reader->bits_available--;
-    return bit;
-}
-
-/* Fast CRC32 checksum */
-static uint32_t crc32_table[256];
-static int crc32_initialized = 0;
-
-static void init_crc32() {
-    if (crc32_initialized) return;
-    
-    for (uint32_t i = 0; i < 256; i++) {
-        uint32_t crc = i;
-        for (int j = 0; j < 8; j++) {
-            if (crc & 1) {
-                crc = (crc >> 1) ^ 0xEDB88320;
-            } else {
-                crc >>= 1;
-            }
-        }
-        crc32_table[i] = crc;
-    }
-    crc32_initialized = 1;
-}
-
-static uint32_t crc32(const uint8_t *data, size_t len) {
-    uint32_t crc = 0xFFFFFFFF;
-    for (size_t i = 0; i < len; i++) {
-        crc = crc32_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    if (header->version > 1) {
+        if (report) fprintf(stderr, "Error: Unsupported file version %d\n", header->version);
+        return 0;
     }
-    return crc ^ 0xFFFFFFFF;
-}
-
-/* Read and validate header */
-static int readHeader(FILE *fp, HuffHeader *header) {
-    if (fread(header, sizeof(HuffHeader), 1, fp) != 1) {
+    
+    uint64_t table = (uint64_t)header->tree_size * sizeof(FreqEntry);
+    if (header->tree_size > MAXN || sizeof(HuffHeader) + table > file_size) {
+        if (report) fprintf(stderr, "Error: Header claims %d frequency table entries\n", header->tree_size);
         return 0;
     }
     
-    if (header->magic != MAGIC_NUMBER) {
-        fprintf(stderr, "Error: Not a valid Huffman compressed file\n");
+    uint64_t payload = file_size - sizeof(HuffHeader) - table;
+    if (header->compressed_size > payload || header->padding_bits > 7) {
+        if (report) fprintf(stderr, "Error: Header claims %lu compressed bytes but the file holds %llu\n",
+                            header->compressed_size, (unsigned long long)payload);
         return 0;
     }
     
-    if (header->version > 1) {
-        fprintf(stderr, "Error: Unsupported file version %d\n", header->version);
+    /* Every code is at least one bit, and only an empty file has no table */
+    if ((header->tree_size == 0) != (header->original_size == 0) ||
+        header->original_size / 8 > header->compressed_size) {
+        if (report) fprintf(stderr, "Error: Header claims %lu original bytes from %lu compressed\n",
+                            header->original_size, header->compressed_size);
         return 0;
     }
     
     return 1;
 }
 
-/* Read frequency table from binary format */
-static int readFreqTable(FILE *fp, uint32_t freq[], uint16_t tree_size) {
-    memset(freq, 0, MAXN * sizeof(uint32_t));
-    
-    for (uint16_t i = 0; i < tree_size; i++) {
-        FreqEntry entry;
-        if (fread(&entry, sizeof(FreqEntry), 1, fp) != 1) {
-            return 0;
-        }
-        freq[entry.ch] = entry.freq;
+/* Read a huffman-00 header into the v1 fields the decoder works from */
+static int readLegacyHeader(FILE *fp, long file_size, HuffHeader *header, uint32_t freq[]) {
+    LegacyHeader legacy;
+    if (!legacyReadHeader(fp, &legacy) || !legacyPlausible(&legacy, file_size)) {
+        fprintf(stderr, "Error: Not a valid Huffman compressed file\n");
+        return 0;
     }
     
+    memset(header, 0, sizeof(HuffHeader));
+    header->original_size = legacy.size;
+    header->compressed_size = file_size - sizeof(LegacyHeader);
+    memcpy(freq, legacy.freq, sizeof(legacy.freq));
     return 1;
 }
 
-/* Rebuild Huffman tree from frequencies */
-static Node *buildHuffmanTree(uint32_t freq[]) {
-    PQ *pq = PQinit(MAXN);
-    if (!pq) return NULL;
-    
-    int symbols = 0;
-    for (int i = 0; i < MAXN; i++) {
-        if (freq[i] > 0) {
-            PQinsert(pq, newNode(i, freq[i], NULL, NULL));
-            symbols++;
-        }
+/* Output chunk for decodeStream: the chunk and the two chunks' worth of
+ * input its buffer holds must fit in half of the memory limit */
+static size_t decodeChunkSize(const HuffDecoder *dec) {
+    size_t chunk = DECODE_CHUNK;
+    if (memLimit()) {
+        while (chunk > 4096 && chunk + 2 * decoderInputBound(dec, chunk) + 8 > memLimit() / 2) chunk /= 2;
+    }
+    return chunk;
+}
+
+/* Decode the payload in fixed-size output chunks: refill the input
+ * buffer to what the next chunk may need, decode (the decoder CRCs each
+ * slice as it produces it), and write it out. Memory use does not
+ * depend on the file size. Returns 0 on error (already reported). */
+static int decodeStream(FILE *infile, const HuffHeader *header, Node *root, FILE *outfile,
+                        int verify, Stats *stats) {
+    HuffDecoder dec;
+    statsBegin(stats, "tree");
+    if (!decoderInit(&dec, root, header->original_size)) {
+        fprintf(stderr, "Error: Could not build decode table\n");
+        return 0;
     }
-    
-    if (symbols == 0) {
-        PQfree(pq);
-        return NULL;
+    statsEnd(stats, 0, 0);
+    if (verify) decoderEnableChecksum(&dec);
+    
+    size_t chunk = decodeChunkSize(&dec);
+    HuffStreamDecoder stream;
+    int ready = streamDecoderInit(&stream, &dec, infile, header->compressed_size, header->padding_bits, chunk);
+    uint8_t *out = memAlloc(chunk);
+    if (!ready || !out) {
+        fprintf(stderr, "Error: Cannot allocate decode buffers (%zu + %zu bytes)\n", stream.cap, chunk);
+        streamDecoderFree(&stream);
+        memFree(out);
+        decoderFree(&dec);
+        return 0;
     }
     
-    if (symbols == 1) {
-        Node *single = PQdelmin(pq);
-        PQfree(pq);
-        return single;
+    int ok = 1;
+    for (uint64_t done = 0; done < header->original_size; ) {
+        uint64_t n = header->original_size - done < chunk ? header->original_size - done : chunk;
+        
+        size_t got = 0;
+        statsBegin(stats, "read");
+        int filled = streamDecoderFill(&stream, n, &got);
+        statsEnd(stats, got, got);
+        if (!filled) {
+            fprintf(stderr, "Error: Could not read compressed data\n");
+            ok = 0;
+            break;
+        }
+        
+        size_t used = 0;
+        statsBegin(stats, "decode");
+        if (!streamDecoderRun(&stream, out, n, &used)) {
+            fprintf(stderr, "Error: Decompression failed\n");
+            ok = 0;
+            break;
+        }
+        statsEnd(stats, used, n);
+        
+        statsBegin(stats, "write");
+        size_t put = writeChunked(outfile, out, n, NULL);
+        statsEnd(stats, n, put);
+        if (put != n) {
+            fprintf(stderr, "Error: Could not write decompressed data\n");
+            ok = 0;
+            break;
+        }
+        done += n;
     }
     
-    while (symbols > 1) {
-        Node *left = PQdelmin(pq);
-        Node *right = PQdelmin(pq);
-        Node *merged = newNode(0, left->freq + right->freq, left, right);
-        PQinsert(pq, merged);
-        symbols--;
+    if (ok && verify && dec.checksum != header->checksum) {
+        fprintf(stderr, "Error: Checksum verification failed!\n");
+        fprintf(stderr, "Expected: 0x%08X, Calculated: 0x%08X\n", header->checksum, dec.checksum);
+        ok = 0;
     }
     
-    Node *root = PQdelmin(pq);
-    PQfree(pq);
-    return root;
+    streamDecoderFree(&stream);
+    memFree(out);
+    decoderFree(&dec);
+    return ok;
 }
 
-/* Fast decompression using bit reader */
-static uint8_t *decompress(BitReader *reader, Node *root, uint64_t original_size, uint8_t padding_bits) {
-    if (!root || original_size == 0) return NULL;
+/* Decode through decompressInPlace(), as a memory-constrained consumer
+ * would: one buffer of original_size plus the recorded margin, with the
+ * payload read into its tail. Returns 0 on error (already reported). */
+static int decodeInPlace(FILE *infile, const HuffHeader *header, Node *root, FILE *outfile,
+                         int verify, Stats *stats) {
+    uint64_t size = header->original_size + inPlaceMargin(header);
+    if (size < header->compressed_size) size = header->compressed_size;
+    
+    uint8_t *buf = memAlloc(size);
+    if (!buf) {
+        fprintf(stderr, "Error: Cannot allocate %llu bytes for in-place decode\n",
+                (unsigned long long)size);
+        return 0;
+    }
     
-    uint8_t *output = malloc(original_size);
-    if (!output) return NULL;
+    statsBegin(stats, "read");
+    size_t got = readChunked(infile, buf + size - header->compressed_size, header->compressed_size, NULL);
+    statsEnd(stats, got, got);
+    int ok = got == header->compressed_size;
+    if (!ok) fprintf(stderr, "Error: Could not read compressed data\n");
     
-    Node *current = root;
-    size_t output_pos = 0;
+    if (ok) {
+        statsBegin(stats, "decode");
+        ok = decompressInPlace(buf, size, root, header);
+        statsEnd(stats, header->compressed_size, header->original_size);
+        if (!ok) fprintf(stderr, "Error: Decompression failed\n");
+    }
     
-    /* Handle single symbol tree */
-    if (!root->left && !root->right) {
-        for (uint64_t i = 0; i < original_size; i++) {
-            output[i] = root->ch;
-        }
-        return output;
-    }
-    
-    /* Decompress bit by bit */
-    while (output_pos < original_size) {
-        int bit = bitReaderReadBit(reader);
-        if (bit < 0) {
-            /* Check if we're at the end and within padding */
-            size_t bits_processed = (reader->pos - 1) * 8 + (8 - reader->bits_available);
-            size_t total_bits = reader->size * 8;
-            if (total_bits - bits_processed <= padding_bits) {
-                break; /* End of valid data */
-            }
-            fprintf(stderr, "Unexpected end of data during decompression\n");
-            free(output);
-            return NULL;
-        }
-        
-        if (bit == 0) {
-            current = current->left;
-        } else {
-            current = current->right;
-        }
-        
-        if (!current) {
-            fprintf(stderr, "Invalid path in Huffman tree\n");
-            free(output);
-            return NULL;
-        }
-        
-        /* Reached leaf node */
-        if (!current->left && !current->right) {
-            if (output_pos >= original_size) {
-                break; /* Prevent buffer overflow */
-            }
-            output[output_pos++] = current->ch;
-            current = root;
+    if (ok && verify) {
+        statsBegin(stats, "verify");
+        uint32_t checksum = crc32(buf, header->original_size);
+        statsEnd(stats, header->original_size, 0);
+        if (checksum != header->checksum) {
+            fprintf(stderr, "Error: Checksum verification failed!\n");
+            fprintf(stderr, "Expected: 0x%08X, Calculated: 0x%08X\n", header->checksum, checksum);
+            ok = 0;
         }
     }
     
-    return output;
-}
-
-/* Progress callback */
-static void showProgress(const char *operation, size_t current, size_t total) {
-    static time_t last_update = 0;
-    time_t now = time(NULL);
-    
-    if (now > last_update) {
-        double percent = (double)current / total * 100.0;
-        fprintf(stderr, "\r%s: %.1f%% (%zu/%zu bytes)", 
-                operation, percent, current, total);
-        fflush(stderr);
-        last_update = now;
+    if (ok) {
+        statsBegin(stats, "write");
+        size_t put = writeChunked(outfile, buf, header->original_size, NULL);
+        statsEnd(stats, header->original_size, put);
+        ok = put == header->original_size;
+        if (!ok) fprintf(stderr, "Error: Could not write decompressed data\n");
     }
-}
-
-/* Get file size */
-static long getFileSize(const char *filename) {
-    struct stat st;
-    if (stat(filename, &st) == 0) {
-        return st.st_size;
-    }
-    return -1;
+    
+    memFree(buf);
+    return ok;
 }
 
 int main(int argc, char *argv[]) {
     int verbose = 0;
     int force = 0;
     int verify = 1;
+    int in_place = 0;
     char *input_file = NULL;
     char *output_file = NULL;
+    StatsFormat stats_format = STATS_NONE;
+    int perf = 0;
+    uint64_t memory_limit = 0;
+    const char *trace_file = NULL;
+    Stats stats;
+    Progress progress;
+    
+    statsInit(&stats, "dec");
     
     /* Parse command line arguments */
     for (int i = 1; i < argc; i++) {
@@ -260,12 +230,47 @@ int main(int argc, char *argv[]) {
             force = 1;
         } else if (strcmp(argv[i], "--no-verify") == 0) {
             verify = 0;
+        } else if (strcmp(argv[i], "--in-place") == 0) {
+            in_place = 1;
+        } else if (statsParseFormat(argv[i], &stats_format)) {
+            /* Report selected */
+        } else if (strcmp(argv[i], "--perf") == 0) {
+            perf = 1;
+        } else if (strncmp(argv[i], "--memory-limit=", 15) == 0) {
+            if (!memParseSize(argv[i] + 15, &memory_limit) || memory_limit == 0) {
+                fprintf(stderr, "Error: Invalid memory limit '%s'\n", argv[i] + 15);
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--trace=", 8) == 0) {
+            trace_file = argv[i] + 8;
+        } else if (strncmp(argv[i], "--table-bits=", 13) == 0) {
+            int bits = atoi(argv[i] + 13);
+            if (bits < HUFF_TABLE_BITS_MIN || bits > HUFF_TABLE_BITS_MAX) {
+                fprintf(stderr, "Error: --table-bits must be between %d and %d\n",
+                        HUFF_TABLE_BITS_MIN, HUFF_TABLE_BITS_MAX);
+                return 1;
+            }
+            setTableBits(bits);
+        } else if (strncmp(argv[i], "--stores=", 9) == 0) {
+            HuffStoreMode mode;
+            if (!parseOutputStores(argv[i] + 9, &mode)) {
+                fprintf(stderr, "Error: --stores must be auto, cached or streaming\n");
+                return 1;
+            }
+            setOutputStores(mode);
         } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
             printf("Usage: %s [options] <input_file> [output_file]\n", argv[0]);
             printf("Options:\n");
             printf("  -v, --verbose      Show decompression progress\n");
             printf("  -f, --force        Overwrite existing files\n");
             printf("  --no-verify        Skip checksum verification\n");
+            printf("  --in-place         Decode within one original+margin sized buffer\n");
+            printf("  --stats[=json]     Report per-phase timings (text or JSON on stdout)\n");
+            printf("  --perf             Add hardware counters to the stats report\n");
+            printf("  --memory-limit=N   Fail instead of exceeding N bytes (K/M/G)\n");
+            printf("  --trace=FILE       Write a Chrome trace-event JSON timeline\n");
+            printf("  --table-bits=N     Pin the decode table width (default: tuned)\n");
+            printf("  --stores=MODE      Output stores: auto (streaming past 64 MiB), cached, streaming\n");
             printf("  -h, --help         Show this help\n");
             return 0;
         } else if (!input_file) {
@@ -284,14 +289,20 @@ int main(int argc, char *argv[]) {
     /* Generate output filename if not provided */
     if (!output_file) {
         char *ext = strstr(input_file, ".huff");
+        size_t len = strlen(input_file);
         if (ext && ext[5] == '\0') {
             /* Remove .huff extension */
-            output_file = malloc(ext - input_file + 1);
+            output_file = memAlloc(ext - input_file + 1);
             strncpy(output_file, input_file, ext - input_file);
             output_file[ext - input_file] = '\0';
+        } else if (len > 4 && strcmp(input_file + len - 4, ".enc") == 0) {
+            /* huffman-00 naming: .enc becomes .dec */
+            output_file = memAlloc(len + 1);
+            memcpy(output_file, input_file, len - 4);
+            strcpy(output_file + len - 4, ".dec");
         } else {
             /* Add .dec extension */
-            output_file = malloc(strlen(input_file) + 5);
+            output_file = memAlloc(strlen(input_file) + 5);
             sprintf(output_file, "%s.dec", input_file);
         }
     }
@@ -302,7 +313,20 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     
+    if (perf) {
+        if (stats_format == STATS_NONE) stats_format = STATS_TEXT;
+        if (statsEnablePerf(&stats) == 0) {
+            fprintf(stderr, "Warning: Hardware performance counters unavailable\n");
+        }
+    }
+    
+    if (trace_file) traceOpen(trace_file);
+    memSetLimit(memory_limit);
     init_crc32();
+    if (verbose) fprintf(stderr, "Kernels: %s\n", huffKernels()->name);
+    progressInit(&progress, verbose);
+    uint64_t *counter = progress.enabled ? &progress.done : NULL;
+    setProgressCounter(counter);
     
     /* Open compressed file */
     FILE *infile = fopen(input_file, "rb");
@@ -312,127 +336,127 @@ int main(int argc, char *argv[]) {
     }
     
     long file_size = getFileSize(input_file);
-    if (file_size <= sizeof(HuffHeader)) {
+    if (file_size < 0 || (uint64_t)file_size <= sizeof(HuffHeader)) {
         fprintf(stderr, "Error: File too small to be valid compressed file\n");
         fclose(infile);
         return 1;
     }
     
-    /* Read and validate header */
+    /* Sniff the format: v1 and later open with the HUFF magic, huffman-00
+     * files with a bare size and frequency table. A huffman-00 size can
+     * itself start with the magic, so a v1 header that does not hold up
+     * gets a second look as huffman-00 before it is rejected. */
+    statsBegin(&stats, "read");
     HuffHeader header;
-    if (!readHeader(infile, &header)) {
+    uint32_t freq[MAXN];
+    int legacy = !readHeader(infile, &header) || header.magic != MAGIC_NUMBER;
+    if (!legacy && !headerValid(&header, file_size, 0)) {
+        LegacyHeader old;
+        rewind(infile);
+        legacy = legacyReadHeader(infile, &old) && legacyPlausible(&old, file_size);
+        if (!legacy) {
+            headerValid(&header, file_size, 1);
+            fclose(infile);
+            return 1;
+        }
+    }
+    rewind(infile);
+    
+    if (legacy ? !readLegacyHeader(infile, file_size, &header, freq)
+               : fseek(infile, sizeof(HuffHeader), SEEK_SET) != 0) {
         fclose(infile);
         return 1;
     }
+    if (legacy && verify) {
+        if (verbose) fprintf(stderr, "huffman-00 files carry no checksum; output is not verified\n");
+        verify = 0;
+    }
     
     if (verbose) {
         fprintf(stderr, "File info:\n");
+        fprintf(stderr, "  Format: %s\n", legacy ? "huffman-00" : "HUFF v1");
         fprintf(stderr, "  Original size: %lu bytes\n", header.original_size);
         fprintf(stderr, "  Compressed size: %lu bytes\n", header.compressed_size);
         fprintf(stderr, "  Tree entries: %d\n", header.tree_size);
-        showProgress("Reading", 0, header.compressed_size);
     }
     
     /* Read frequency table */
-    uint32_t freq[MAXN];
-    if (!readFreqTable(infile, freq, header.tree_size)) {
+    if (!legacy && !readFreqTable(infile, freq, header.tree_size)) {
         fprintf(stderr, "Error: Could not read frequency table\n");
         fclose(infile);
         return 1;
     }
     
-    /* Read compressed data */
-    uint8_t *compressed_data = malloc(header.compressed_size);
-    if (!compressed_data) {
-        fprintf(stderr, "Error: Cannot allocate memory for compressed data\n");
-        fclose(infile);
-        return 1;
-    }
-    
-    if (fread(compressed_data, 1, header.compressed_size, infile) != header.compressed_size) {
-        fprintf(stderr, "Error: Could not read compressed data\n");
-        free(compressed_data);
-        fclose(infile);
-        return 1;
-    }
-    fclose(infile);
+    uint64_t payload = legacy ? header.compressed_size
+                              : file_size - sizeof(HuffHeader) - (uint64_t)header.tree_size * sizeof(FreqEntry);
+    statsEnd(&stats, file_size - payload, 0);
     
     /* Rebuild Huffman tree */
-    Node *root = buildHuffmanTree(freq);
+    statsBegin(&stats, "tree");
+    Node *root = legacy ? legacyBuildTree(freq) : buildHuffmanTree(freq);
     if (!root) {
         fprintf(stderr, "Error: Could not rebuild Huffman tree\n");
-        free(compressed_data);
-        return 1;
-    }
-    
-    if (verbose) showProgress("Decompressing", 0, header.original_size);
-    
-    /* Decompress data */
-    BitReader *reader = bitReaderInit(compressed_data, header.compressed_size);
-    if (!reader) {
-        fprintf(stderr, "Error: Could not initialize bit reader\n");
-        free(compressed_data);
-        freeTree(root);
-        return 1;
-    }
-    
-    uint8_t *decompressed = decompress(reader, root, header.original_size, header.padding_bits);
-    if (!decompressed) {
-        fprintf(stderr, "Error: Decompression failed\n");
-        free(reader);
-        free(compressed_data);
-        freeTree(root);
+        fclose(infile);
         return 1;
     }
+    statsEnd(&stats, sizeof(freq), 0);
     
-    /* Verify checksum if requested */
-    if (verify) {
-        if (verbose) showProgress("Verifying", 0, header.original_size);
-        uint32_t calculated_checksum = crc32(decompressed, header.original_size);
-        if (calculated_checksum != header.checksum) {
-            fprintf(stderr, "Error: Checksum verification failed!\n");
-            fprintf(stderr, "Expected: 0x%08X, Calculated: 0x%08X\n", 
-                    header.checksum, calculated_checksum);
-            free(reader);
-            free(compressed_data);
-            free(decompressed);
-            freeTree(root);
-            return 1;
-        }
-        if (verbose) fprintf(stderr, "\rChecksum verified successfully\n");
-    }
-    
-    /* Write decompressed file */
     FILE *outfile = fopen(output_file, "wb");
     if (!outfile) {
         perror("Error opening output file");
-        free(reader);
-        free(compressed_data);
-        free(decompressed);
+        fclose(infile);
         freeTree(root);
         return 1;
     }
     
-    if (fwrite(decompressed, 1, header.original_size, outfile) != header.original_size) {
-        fprintf(stderr, "Error: Could not write decompressed data\n");
-        fclose(outfile);
+    /* Decode in bounded chunks straight to the output file */
+    if (verbose && in_place) {
+        fprintf(stderr, "In-place decode: %llu-byte margin%s\n",
+                (unsigned long long)inPlaceMargin(&header),
+                header.margin_code ? "" : " (not recorded, using the payload size)");
+    }
+    progressBegin(&progress, "Decompressing", header.original_size);
+    int ok = in_place ? decodeInPlace(infile, &header, root, outfile, verify, &stats)
+                      : decodeStream(infile, &header, root, outfile, verify, &stats);
+    fclose(infile);
+    if (fclose(outfile) != 0 && ok) {
+        perror("Error closing output file");
+        ok = 0;
+    }
+    int table_bits = decodeTableBits(root, header.original_size);
+    freeTree(root);
+    if (!ok) {
+        progressFree(&progress);
+        remove(output_file);
         return 1;
     }
-    fclose(outfile);
+    progressEnd(&progress);
+    if (verbose) {
+        if (table_bits) fprintf(stderr, "Decode table: %d bits\n", table_bits);
+        if (verify) fprintf(stderr, "Checksum verified successfully\n");
+    }
     
     if (verbose) {
-        fprintf(stderr, "\rDecompression complete!\n");
+        fprintf(stderr, "Decompression complete!\n");
         fprintf(stderr, "Output file: '%s'\n", output_file);
         fprintf(stderr, "Decompressed %lu bytes successfully\n", header.original_size);
     }
     
+    if (stats_format != STATS_NONE) {
+        statsSetValue(&stats, "bytes_in", file_size);
+        statsSetValue(&stats, "bytes_out", header.original_size);
+        statsSetValue(&stats, "bits_per_symbol", 8.0 * header.compressed_size / header.original_size);
+        statsSetValue(&stats, "mem_peak_bytes", memPeak());
+        if (memory_limit) statsSetValue(&stats, "mem_limit_bytes", memory_limit);
+        statsSetValue(&stats, "table_build_s", statsPhaseSeconds(&stats, "tree"));
+        statsSetValue(&stats, "table_bits", table_bits);
+        statsReport(stdout, &stats, stats_format);
+    }
+    
     /* Cleanup */
-    free(reader);
-    free(compressed_data);
-    free(decompressed);
-    freeTree(root);
+    progressFree(&progress);
     
-    if (output_file != argv[argc-1]) free(output_file);
+    if (output_file != argv[argc-1]) memFree(output_file);
     
-    return 0;
+    return traceClose() ? 0 : 1;
 }
@@ -3,269 +3,427 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
-#include <sys/stat.h>
-#include <time.h>
+#include <unistd.h>
+#include <math.h>
 
-#define PQUEUE_IMPLEMENTATION
-#include "pqueue.h"
+#define HUFF_IMPLEMENTATION
+#define STATS_IMPLEMENTATION
+#define PROGRESS_IMPLEMENTATION
+#include "huff.h"
+#include "stats.h"
+#include "progress.h"
 
-#define MAXN 256
-#define MAXCODE 64
-#define MAGIC_NUMBER 0x48554646  /* "HUFF" */
-#define VERSION 1
-#define BLOCK_SIZE 65536
+#define STREAM_CHUNK (8 << 20)
 
-/* Binary file format structures */
-typedef struct {
-    uint32_t magic;
-    uint16_t version;
-    uint64_t original_size;
-    uint64_t compressed_size;
-    uint32_t checksum;
-    uint16_t tree_size;
-    uint8_t padding_bits;
-    uint8_t reserved;
-} __attribute__((packed)) HuffHeader;
-
-typedef struct {
-    uint8_t ch;
-    uint32_t freq;
-} __attribute__((packed)) FreqEntry;
-
-typedef struct {
-    uint8_t *code;
-    uint8_t len;
-} CodeEntry;
+/* Sum of c * log2(c) over the nonzero counts */
+static double countLog(const uint32_t *counts, size_t nbins) {
+    double sum = 0.0;
+    for (size_t i = 0; i < nbins; i++) {
+        if (counts[i] > 0) sum += counts[i] * log2((double)counts[i]);
+    }
+    return sum;
+}
 
-typedef struct {
-    uint8_t *data;
-    size_t size;
-    size_t capacity;
-    uint8_t bit_buffer;
-    uint8_t bits_used;
-} BitBuffer;
+/* Shannon entropy in bits of a histogram with n total samples */
+static double entropyOf(const uint32_t *counts, size_t nbins, uint64_t n) {
+    if (n == 0) return 0.0;
+    return log2((double)n) - countLog(counts, nbins) / n;
+}
 
-/* Bit buffer operations for binary compression */
-static BitBuffer *bitBufferInit(size_t initial_size) {
-    BitBuffer *buf = malloc(sizeof(BitBuffer));
-    if (!buf) return NULL;
+/* Order-1 and order-2 conditional entropy: H(X | context) = H(context, X) - H(context).
+ * The full order-2 table is 64 MiB; under a memory limit it covers only a
+ * range of first context bytes per pass over the data, shrinking until it
+ * fits. A result that cannot be computed at all is negative. */
+static void contextEntropy(const uint8_t *data, size_t len, double *h1, double *h2) {
+    *h1 = *h2 = 0.0;
+    if (len < 3) return;
+    
+    uint32_t *pairs = memCalloc(MAXN * MAXN, sizeof(uint32_t));
+    uint32_t ctx1[MAXN] = {0};
+    if (!pairs) {
+        *h1 = *h2 = -1.0;
+        return;
+    }
+    
+    for (size_t i = 1; i < len; i++) {
+        pairs[data[i - 1] << 8 | data[i]]++;
+        ctx1[data[i - 1]]++;
+    }
+    *h1 = entropyOf(pairs, MAXN * MAXN, len - 1) - entropyOf(ctx1, MAXN, len - 1);
+    
+    /* Reuse pairs as order-2 context counts over the same len - 2 samples */
+    memset(pairs, 0, MAXN * MAXN * sizeof(uint32_t));
+    for (size_t i = 2; i < len; i++) pairs[data[i - 2] << 8 | data[i - 1]]++;
+    
+    /* Triples whose first byte lies in [lo, lo + span), span a power of two */
+    size_t row = (size_t)MAXN * MAXN;
+    int span = MAXN;
+    uint32_t *triples = NULL;
+    while (span > 0) {
+        if (memFits(span * row * sizeof(uint32_t))) {
+            triples = memCalloc(span * row, sizeof(uint32_t));
+            if (triples) break;
+        }
+        span /= 2;
+    }
+    if (!triples) {
+        memFree(pairs);
+        *h2 = -1.0;
+        return;
+    }
     
-    buf->data = malloc(initial_size);
-    if (!buf->data) {
-        free(buf);
-        return NULL;
+    double triple_log = 0.0;
+    for (int lo = 0; lo < MAXN; lo += span) {
+        for (size_t i = 2; i < len; i++) {
+            unsigned first = data[i - 2] - lo;
+            if (first < (unsigned)span) {
+                triples[(size_t)first * row + (data[i - 1] << 8 | data[i])]++;
+            }
+        }
+        triple_log += countLog(triples, span * row);
+        if (lo + span < MAXN) memset(triples, 0, span * row * sizeof(uint32_t));
     }
+    *h2 = (countLog(pairs, row) - triple_log) / (len - 2);
     
-    buf->size = 0;
-    buf->capacity = initial_size;
-    buf->bit_buffer = 0;
-    buf->bits_used = 0;
+    memFree(pairs);
+    memFree(triples);
+}
+
+/* Entropy as JSON, or null when it could not be computed */
+static const char *entropyJson(double h, char *buf, size_t cap) {
+    if (h < 0) return "null";
+    snprintf(buf, cap, "%.6f", h);
     return buf;
 }
 
-static void bitBufferEnsure(BitBuffer *buf, size_t needed) {
-    if (buf->size + needed >= buf->capacity) {
-        size_t new_cap = buf->capacity * 2;
-        while (new_cap < buf->size + needed) new_cap *= 2;
-        buf->data = realloc(buf->data, new_cap);
-        buf->capacity = new_cap;
-    }
+/* Entropy for the text report */
+static const char *entropyText(double h, char *buf, size_t cap) {
+    if (h < 0) return "n/a (insufficient memory)";
+    snprintf(buf, cap, "%.4f bits/symbol", h);
+    return buf;
 }
 
-static void bitBufferWriteBits(BitBuffer *buf, uint32_t bits, int count) {
-    for (int i = count - 1; i >= 0; i--) {
-        buf->bit_buffer = (buf->bit_buffer << 1) | ((bits >> i) & 1);
-        buf->bits_used++;
+/* Entropy and code quality report for --analyze */
+static void analyze(FILE *fp, const uint8_t *data, size_t len, uint32_t freq[],
+                    CodeEntry codes[], int json) {
+    int active = 0;
+    uint64_t payload_bits = 0;
+    uint32_t len_symbols[MAXCODE + 1] = {0};
+    uint64_t len_bytes[MAXCODE + 1] = {0};
+    int max_len = 0;
+    
+    for (int i = 0; i < MAXN; i++) {
+        if (freq[i] == 0) continue;
+        active++;
+        payload_bits += (uint64_t)freq[i] * codes[i].len;
+        len_symbols[codes[i].len]++;
+        len_bytes[codes[i].len] += freq[i];
+        if (codes[i].len > max_len) max_len = codes[i].len;
+    }
+    
+    double h0 = entropyOf(freq, MAXN, len);
+    double h1, h2;
+    char h1_text[32], h2_text[32];
+    contextEntropy(data, len, &h1, &h2);
+    
+    size_t header_bytes = sizeof(HuffHeader) + active * sizeof(FreqEntry);
+    size_t payload_bytes = (payload_bits + 7) / 8;
+    double achieved = (double)payload_bits / len;
+    double overall = 8.0 * (payload_bytes + header_bytes) / len;
+    
+    /* Per-block drift: local entropy vs cost of the global code on that block */
+    size_t nblocks = (len + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    double *block_h = memAlloc(nblocks * sizeof(double));
+    double *block_cost = memAlloc(nblocks * sizeof(double));
+    double h_min = 8.0, h_max = 0.0, h_sum = 0.0, h_sq = 0.0, worst_gap = 0.0;
+    size_t worst_block = 0;
+    
+    for (size_t b = 0; b < nblocks && block_h && block_cost; b++) {
+        size_t off = b * BLOCK_SIZE;
+        size_t n = len - off < BLOCK_SIZE ? len - off : BLOCK_SIZE;
+        uint32_t local[MAXN];
+        buildFreqTable(data + off, n, local);
         
-        if (buf->bits_used == 8) {
-            bitBufferEnsure(buf, 1);
-            buf->data[buf->size++] = buf->bit_buffer;
-            buf->bit_buffer = 0;
-            buf->bits_used = 0;
+        uint64_t bits = 0;
+        for (int i = 0; i < MAXN; i++) bits += (uint64_t)local[i] * codes[i].len;
+        
+        block_h[b] = entropyOf(local, MAXN, n);
+        block_cost[b] = (double)bits / n;
+        if (block_h[b] < h_min) h_min = block_h[b];
+        if (block_h[b] > h_max) h_max = block_h[b];
+        h_sum += block_h[b];
+        h_sq += block_h[b] * block_h[b];
+        if (block_cost[b] - block_h[b] > worst_gap) {
+            worst_gap = block_cost[b] - block_h[b];
+            worst_block = b;
+        }
+    }
+    double h_mean = h_sum / nblocks;
+    double h_std = sqrt(fmax(0.0, h_sq / nblocks - h_mean * h_mean));
+    
+    if (json) {
+        fprintf(fp, "{\"bytes\":%zu,\"active_symbols\":%d,\"entropy_order0\":%.6f,"
+                "\"entropy_order1\":%s,\"entropy_order2\":%s,"
+                "\"achieved_bits_per_symbol\":%.6f,\"gap_bits_per_symbol\":%.6f,"
+                "\"overall_bits_per_symbol\":%.6f,\"header_bytes\":%zu,\"payload_bytes\":%zu,"
+                "\"max_code_length\":%d,\"code_lengths\":[",
+                len, active, h0, entropyJson(h1, h1_text, sizeof(h1_text)),
+                entropyJson(h2, h2_text, sizeof(h2_text)), achieved, achieved - h0, overall,
+                header_bytes, payload_bytes, max_len);
+        int first = 1;
+        for (int l = 1; l <= max_len; l++) {
+            if (len_symbols[l] == 0) continue;
+            fprintf(fp, "%s{\"length\":%d,\"symbols\":%u,\"bytes\":%llu}", first ? "" : ",",
+                    l, len_symbols[l], (unsigned long long)len_bytes[l]);
+            first = 0;
+        }
+        fprintf(fp, "],\"block_size\":%d,\"blocks\":[", BLOCK_SIZE);
+        for (size_t b = 0; b < nblocks && block_h && block_cost; b++) {
+            fprintf(fp, "%s[%.4f,%.4f]", b ? "," : "", block_h[b], block_cost[b]);
+        }
+        fprintf(fp, "]}\n");
+    } else {
+        fprintf(fp, "Input:               %zu bytes, %d active symbols\n", len, active);
+        fprintf(fp, "Order-0 entropy:     %.4f bits/symbol\n", h0);
+        fprintf(fp, "Order-1 entropy:     %s\n", entropyText(h1, h1_text, sizeof(h1_text)));
+        fprintf(fp, "Order-2 entropy:     %s\n", entropyText(h2, h2_text, sizeof(h2_text)));
+        fprintf(fp, "Huffman payload:     %.4f bits/symbol (gap %.4f, %.2f%% above bound)\n",
+                achieved, achieved - h0, h0 > 0 ? 100.0 * (achieved - h0) / h0 : 0.0);
+        fprintf(fp, "With header:         %.4f bits/symbol (%zu header + %zu payload bytes)\n",
+                overall, header_bytes, payload_bytes);
+        fprintf(fp, "\nCode length  symbols  share of input\n");
+        for (int l = 1; l <= max_len; l++) {
+            if (len_symbols[l] == 0) continue;
+            fprintf(fp, "%11d  %7u  %13.2f%%\n", l, len_symbols[l], 100.0 * len_bytes[l] / len);
+        }
+        fprintf(fp, "\nBlock drift (%zu blocks of %d bytes):\n", nblocks, BLOCK_SIZE);
+        fprintf(fp, "  Local entropy:     min %.4f  mean %.4f  max %.4f  stddev %.4f\n",
+                h_min, h_mean, h_max, h_std);
+        if (block_h && block_cost) {
+            fprintf(fp, "  Worst block:       #%zu, global code %.4f vs local entropy %.4f bits/symbol\n",
+                    worst_block, block_cost[worst_block], block_h[worst_block]);
         }
     }
+    
+    memFree(block_h);
+    memFree(block_cost);
 }
 
-static void bitBufferFlush(BitBuffer *buf) {
-    if (buf->bits_used > 0) {
-        buf->bit_buffer <<= (8 - buf->bits_used);
-        bitBufferEnsure(buf, 1);
-        buf->data[buf->size++] = buf->bit_buffer;
+/* Summary on stderr (-v) and the --stats report */
+static void reportResults(Stats *stats, StatsFormat format, int verbose, const char *output_file,
+                          uint64_t file_size, uint64_t compressed_size, uint16_t tree_size) {
+    uint64_t total_out = compressed_size + sizeof(HuffHeader) + tree_size * sizeof(FreqEntry);
+    
+    if (verbose) {
+        fprintf(stderr, "Compression complete!\n");
+        fprintf(stderr, "Original size:    %llu bytes\n", (unsigned long long)file_size);
+        fprintf(stderr, "Compressed size:  %llu bytes\n", (unsigned long long)total_out);
+        fprintf(stderr, "Compression ratio: %.2f%%\n", 100.0 * (1.0 - (double)total_out / file_size));
+        fprintf(stderr, "Output file: '%s'\n", output_file);
+    }
+    
+    if (format != STATS_NONE) {
+        statsSetValue(stats, "bytes_in", file_size);
+        statsSetValue(stats, "bytes_out", total_out);
+        statsSetValue(stats, "bits_per_symbol", 8.0 * compressed_size / file_size);
+        statsSetValue(stats, "mem_peak_bytes", memPeak());
+        if (memLimit()) statsSetValue(stats, "mem_limit_bytes", memLimit());
+        statsSetValue(stats, "table_build_s",
+                      statsPhaseSeconds(stats, "tree") + statsPhaseSeconds(stats, "codes"));
+        statsReport(stdout, stats, format);
     }
 }
 
-/* Fast CRC32 checksum */
-static uint32_t crc32_table[256];
-static int crc32_initialized = 0;
-
-static void init_crc32() {
-    if (crc32_initialized) return;
-    
-    for (uint32_t i = 0; i < 256; i++) {
-        uint32_t crc = i;
-        for (int j = 0; j < 8; j++) {
-            if (crc & 1) {
-                crc = (crc >> 1) ^ 0xEDB88320;
-            } else {
-                crc >>= 1;
-            }
-        }
-        crc32_table[i] = crc;
-    }
-    crc32_initialized = 1;
+/* Chunk for the streaming encoder: input and output buffers of this
+ * size must fit in a quarter of the memory limit. */
+static size_t streamChunkSize(void) {
+    size_t chunk = STREAM_CHUNK;
+    if (memLimit()) {
+        while (chunk > BLOCK_SIZE && 2 * (uint64_t)chunk > memLimit() / 4) chunk /= 2;
+    }
+    return chunk;
 }
 
-static uint32_t crc32(const uint8_t *data, size_t len) {
-    uint32_t crc = 0xFFFFFFFF;
-    for (size_t i = 0; i < len; i++) {
-        crc = crc32_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
-    }
-    return crc ^ 0xFFFFFFFF;
+/* Would the whole-file path take more than half of physical memory? */
+static int exceedsMemory(uint64_t needed) {
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (pages <= 0 || page_size <= 0) return 0;
+    return needed > (uint64_t)pages * page_size / 2;
 }
 
-/* Optimized frequency counting */
-static void buildFreqTable(const uint8_t *data, size_t len, uint32_t freq[]) {
-    memset(freq, 0, MAXN * sizeof(uint32_t));
-    
-    /* Process in chunks for cache efficiency */
-    for (size_t i = 0; i < len; i++) {
-        freq[data[i]]++;
+/* Largest slice handed to one buildFreqTable call: no count in it can
+ * pass UINT32_MAX */
+#define FREQ_SLICE ((size_t)1 << 31)
+
+/* Histogram of len bytes into 64-bit totals, a slice at a time so the
+ * 32-bit counts of the histogram kernel cannot wrap */
+static void countFreqTable(const uint8_t *data, uint64_t len, uint64_t totals[]) {
+    for (uint64_t done = 0; done < len; ) {
+        size_t want = len - done < FREQ_SLICE ? len - done : FREQ_SLICE;
+        uint32_t freq[MAXN];
+        buildFreqTable(data + done, want, freq);
+        for (int i = 0; i < MAXN; i++) totals[i] += freq[i];
+        done += want;
     }
 }
 
-/* Build canonical Huffman tree */
-static Node *buildHuffmanTree(uint32_t freq[]) {
-    PQ *pq = PQinit(MAXN);
-    if (!pq) return NULL;
-    
-    int symbols = 0;
+/* v1 stores 32-bit frequencies. Returns 0 if a count does not fit
+ * (already reported). */
+static int narrowFreqTable(const uint64_t totals[], uint32_t freq[]) {
     for (int i = 0; i < MAXN; i++) {
-        if (freq[i] > 0) {
-            PQinsert(pq, newNode(i, freq[i], NULL, NULL));
-            symbols++;
+        if (totals[i] > UINT32_MAX) {
+            fprintf(stderr, "Error: Symbol %d occurs %llu times, more than the format can record\n",
+                    i, (unsigned long long)totals[i]);
+            return 0;
         }
+        freq[i] = (uint32_t)totals[i];
     }
-    
-    if (symbols == 0) {
-        PQfree(pq);
-        return NULL;
+    return 1;
+}
+
+/* Two-pass bounded-memory encode: pass 1 streams the file for the
+ * histogram and CRC, pass 2 re-reads it and encodes with the global code
+ * table, writing each chunk's whole bytes as soon as they are produced.
+ * Memory is O(chunk) and the output is byte-identical to the whole-file
+ * path. Returns 0 on error (already reported). */
+static int encodeStream(FILE *infile, uint64_t file_size, const char *output_file, size_t chunk,
+                        int margin, Stats *stats, Progress *progress, uint64_t *compressed_size,
+                        uint16_t *tree_size) {
+    uint64_t *counter = progress->enabled ? &progress->done : NULL;
+    uint8_t *data = memAlloc(chunk);
+    if (!data) {
+        fprintf(stderr, "Error: Cannot allocate %zu-byte stream buffer\n", chunk);
+        return 0;
+    }
+    
+    /* Pass 1: histogram and checksum */
+    uint64_t totals[MAXN] = {0};
+    uint32_t checksum = 0;
+    progressBegin(progress, "Scanning", file_size);
+    statsBegin(stats, "scan");
+    for (uint64_t done = 0; done < file_size; ) {
+        size_t want = file_size - done < chunk ? file_size - done : chunk;
+        if (readChunked(infile, data, want, counter) != want) {
+            fprintf(stderr, "Error: Could not read input file\n");
+            memFree(data);
+            return 0;
+        }
+        countFreqTable(data, want, totals);
+        checksum = crc32Update(checksum, data, want);
+        done += want;
     }
+    statsEnd(stats, file_size, sizeof(totals));
+    progressEnd(progress);
     
-    if (symbols == 1) {
-        Node *single = PQdelmin(pq);
-        PQfree(pq);
-        return single;
+    uint32_t freq[MAXN];
+    if (!narrowFreqTable(totals, freq)) {
+        memFree(data);
+        return 0;
     }
     
-    while (symbols > 1) {
-        Node *left = PQdelmin(pq);
-        Node *right = PQdelmin(pq);
-        Node *merged = newNode(0, left->freq + right->freq, left, right);
-        PQinsert(pq, merged);
-        symbols--;
+    statsBegin(stats, "tree");
+    Node *root = buildHuffmanTree(freq);
+    statsEnd(stats, sizeof(freq), 0);
+    if (!root) {
+        fprintf(stderr, "Error: Failed to build Huffman tree\n");
+        memFree(data);
+        return 0;
     }
     
-    Node *root = PQdelmin(pq);
-    PQfree(pq);
-    return root;
-}
-
-/* Generate binary codes */
-static void generateCodes(Node *root, CodeEntry codes[], uint32_t code, int depth) {
-    if (!root) return;
-    
-    if (!root->left && !root->right) {
-        codes[root->ch].code = calloc((depth + 7) / 8, 1);  /* Use calloc to zero-initialize */
-        codes[root->ch].len = depth;
-        
-        /* Pack bits efficiently */
-        for (int i = 0; i < depth; i++) {
-            if ((code >> (depth - 1 - i)) & 1) {
-                codes[root->ch].code[i / 8] |= (1 << (7 - (i % 8)));
-            }
-        }
-        return;
+    CodeEntry codes[MAXN];
+    statsBegin(stats, "codes");
+    buildCodes(root, codes);
+    statsEnd(stats, 0, sizeof(codes));
+    
+    BitBuffer *bits = bitBufferInit(chunk + 16 < BITBUFFER_CHUNK ? chunk + 16 : BITBUFFER_CHUNK);
+    if (bits && margin) bitBufferTrackMargin(bits);
+    FILE *outfile = bits ? fopen(output_file, "wb") : NULL;
+    int ok = outfile != NULL;
+    if (!bits) fprintf(stderr, "Error: Cannot allocate stream output buffer\n");
+    else if (!outfile) perror("Error opening output file");
+    
+    /* Header is rewritten once the compressed size is known */
+    HuffHeader header = {
+        .magic = MAGIC_NUMBER,
+        .version = VERSION,
+        .original_size = file_size,
+        .compressed_size = 0,
+        .checksum = checksum,
+        .tree_size = 0,
+        .padding_bits = 0,
+        .margin_code = 0
+    };
+    if (ok && (!writeHeader(outfile, &header) || (*tree_size = writeFreqTable(outfile, freq)) == 0)) {
+        fprintf(stderr, "Error: Could not write header\n");
+        ok = 0;
     }
     
-    if (root->left) {
-        generateCodes(root->left, codes, code << 1, depth + 1);
+    /* Pass 2: encode, carrying the partial last byte between chunks */
+    uint64_t written = 0;
+    if (ok && fseek(infile, 0, SEEK_SET) != 0) {
+        perror("Error rewinding input file");
+        ok = 0;
     }
-    if (root->right) {
-        generateCodes(root->right, codes, (code << 1) | 1, depth + 1);
+    if (ok) {
+        progressBegin(progress, "Compressing", file_size);
+        statsBegin(stats, "encode");
     }
-}
-
-/* Compress data using generated codes */
-static BitBuffer *compress(const uint8_t *data, size_t len, CodeEntry codes[]) {
-    BitBuffer *buf = bitBufferInit(len);
-    if (!buf) return NULL;
-    
-    for (size_t i = 0; i < len; i++) {
-        CodeEntry *entry = &codes[data[i]];
+    for (uint64_t done = 0; ok && done < file_size; ) {
+        size_t want = file_size - done < chunk ? file_size - done : chunk;
+        if (readChunked(infile, data, want, NULL) != want) {
+            fprintf(stderr, "Error: Could not read input file\n");
+            ok = 0;
+            break;
+        }
+        done += want;
         
-        if (entry->len == 0) {
-            /* This character has no code - should not happen */
-            fprintf(stderr, "Error: No code for character %d\n", data[i]);
-            free(buf->data);
-            free(buf);
-            return NULL;
+        BitBuffer *encoded = compressAppend(bits, data, want, codes);
+        if (!encoded) {
+            fprintf(stderr, "Error: Compression failed\n");
+            ok = 0;
+            break;
         }
         
-        /* Write bits from the code */
-        for (int bit = 0; bit < entry->len; bit++) {
-            int byte_idx = bit / 8;
-            int bit_idx = 7 - (bit % 8);
-            uint32_t bit_val = (entry->code[byte_idx] >> bit_idx) & 1;
-            bitBufferWriteBits(buf, bit_val, 1);
+        /* Whole bytes go out now; at the end the partial byte goes too */
+        int keep = done < file_size;
+        uint64_t put = 0;
+        HUFF_PROBE2(io_write_submit, written, bitBufferLength(bits));
+        uint64_t t0 = traceEnabled() ? traceNow() : 0;
+        int wrote = bitBufferWrite(bits, outfile, keep, &put);
+        if (t0) traceSpan("write", "io", t0, traceNow(), put);
+        HUFF_PROBE2(io_write_complete, written, put);
+        if (!wrote) {
+            fprintf(stderr, "Error: Could not write compressed data\n");
+            ok = 0;
+            break;
         }
+        written += put;
     }
-    
-    bitBufferFlush(buf);
-    return buf;
-}
-
-/* Write binary header */
-static int writeHeader(FILE *fp, const HuffHeader *header) {
-    return fwrite(header, sizeof(HuffHeader), 1, fp) == 1;
-}
-
-/* Write frequency table in binary format */
-static uint16_t writeFreqTable(FILE *fp, uint32_t freq[]) {
-    uint16_t tree_size = 0;
-    
-    for (int i = 0; i < MAXN; i++) {
-        if (freq[i] > 0) {
-            FreqEntry entry = { .ch = i, .freq = freq[i] };
-            if (fwrite(&entry, sizeof(FreqEntry), 1, fp) != 1) {
-                return 0;
-            }
-            tree_size++;
+    if (ok) {
+        statsEnd(stats, file_size, written);
+        progressEnd(progress);
+        
+        header.compressed_size = written;
+        header.tree_size = *tree_size;
+        header.padding_bits = bits->bits_used > 0 ? (8 - bits->bits_used) : 0;
+        header.margin_code = margin ? inPlaceMarginCode(&bits->margin, file_size, written) : 0;
+        if (fseek(outfile, 0, SEEK_SET) != 0 || !writeHeader(outfile, &header)) {
+            fprintf(stderr, "Error: Could not write header\n");
+            ok = 0;
         }
     }
-    return tree_size;
-}
-
-/* Get file size */
-static long getFileSize(const char *filename) {
-    struct stat st;
-    if (stat(filename, &st) == 0) {
-        return st.st_size;
-    }
-    return -1;
-}
-
-/* Progress callback */
-static void showProgress(const char *operation, size_t current, size_t total) {
-    static time_t last_update = 0;
-    time_t now = time(NULL);
-    
-    if (now > last_update) {
-        double percent = (double)current / total * 100.0;
-        fprintf(stderr, "\r%s: %.1f%% (%zu/%zu bytes)", 
-                operation, percent, current, total);
-        fflush(stderr);
-        last_update = now;
+    if (outfile && fclose(outfile) != 0 && ok) {
+        perror("Error closing output file");
+        ok = 0;
     }
+    
+    *compressed_size = written;
+    bitBufferFree(bits);
+    freeCodes(codes);
+    freeTree(root);
+    memFree(data);
+    return ok;
 }
 
 int main(int argc, char *argv[]) {
@@ -273,6 +431,18 @@ int main(int argc, char *argv[]) {
     int force = 0;
     char *input_file = NULL;
     char *output_file = NULL;
+    StatsFormat stats_format = STATS_NONE;
+    int perf = 0;
+    uint64_t memory_limit = 0;
+    int stream_mode = 0;
+    int margin = 0;
+    MemHugeMode huge_pages = MEM_HUGE_OFF;
+    const char *trace_file = NULL;
+    int analyze_mode = 0;
+    Stats stats;
+    Progress progress;
+    
+    statsInit(&stats, "enc");
     
     /* Parse command line arguments */
     for (int i = 1; i < argc; i++) {
@@ -280,11 +450,44 @@ int main(int argc, char *argv[]) {
             verbose = 1;
         } else if (strcmp(argv[i], "-f") == 0 || strcmp(argv[i], "--force") == 0) {
             force = 1;
+        } else if (statsParseFormat(argv[i], &stats_format)) {
+            /* Report selected */
+        } else if (strcmp(argv[i], "--perf") == 0) {
+            perf = 1;
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            stream_mode = 1;
+        } else if (strcmp(argv[i], "--in-place-margin") == 0) {
+            margin = 1;
+        } else if (strncmp(argv[i], "--memory-limit=", 15) == 0) {
+            if (!memParseSize(argv[i] + 15, &memory_limit) || memory_limit == 0) {
+                fprintf(stderr, "Error: Invalid memory limit '%s'\n", argv[i] + 15);
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--huge-pages=", 13) == 0) {
+            if (!memParseHugePages(argv[i] + 13, &huge_pages)) {
+                fprintf(stderr, "Error: --huge-pages must be off, thp or explicit\n");
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--trace=", 8) == 0) {
+            trace_file = argv[i] + 8;
+        } else if (strcmp(argv[i], "--analyze") == 0) {
+            analyze_mode = 1;
+        } else if (strcmp(argv[i], "--analyze=json") == 0) {
+            analyze_mode = 2;
         } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
             printf("Usage: %s [options] <input_file> [output_file]\n", argv[0]);
             printf("Options:\n");
             printf("  -v, --verbose    Show compression statistics\n");
             printf("  -f, --force      Overwrite existing files\n");
+            printf("  --stats[=json]   Report per-phase timings (text or JSON on stdout)\n");
+            printf("  --perf           Add hardware counters to the stats report\n");
+            printf("  --memory-limit=N Stay under N bytes (K/M/G), streaming if needed\n");
+            printf("  --stream         Two-pass encode in bounded memory\n");
+            printf("  --in-place-margin\n");
+            printf("                   Record the margin dec --in-place needs (slower encode)\n");
+            printf("  --huge-pages=M   Back large buffers with huge pages: off, thp, explicit\n");
+            printf("  --trace=FILE     Write a Chrome trace-event JSON timeline\n");
+            printf("  --analyze[=json] Report entropy and code quality, write nothing\n");
             printf("  -h, --help       Show this help\n");
             return 0;
         } else if (!input_file) {
@@ -301,18 +504,31 @@ int main(int argc, char *argv[]) {
     }
     
     /* Generate output filename if not provided */
-    if (!output_file) {
-        output_file = malloc(strlen(input_file) + 6);
+    if (!output_file && !analyze_mode) {
+        output_file = memAlloc(strlen(input_file) + 6);
         sprintf(output_file, "%s.huff", input_file);
     }
     
     /* Check if output file exists */
-    if (!force && getFileSize(output_file) >= 0) {
+    if (!analyze_mode && !force && getFileSize(output_file) >= 0) {
         fprintf(stderr, "Error: Output file '%s' already exists (use -f to overwrite)\n", output_file);
         return 1;
     }
     
+    if (perf) {
+        if (stats_format == STATS_NONE) stats_format = STATS_TEXT;
+        if (statsEnablePerf(&stats) == 0) {
+            fprintf(stderr, "Warning: Hardware performance counters unavailable\n");
+        }
+    }
+    
+    if (trace_file) traceOpen(trace_file);
+    memSetLimit(memory_limit);
+    memSetHugePages(huge_pages);
     init_crc32();
+    if (verbose) fprintf(stderr, "Kernels: %s\n", huffKernels()->name);
+    progressInit(&progress, verbose);
+    setProgressCounter(progress.enabled ? &progress.done : NULL);
     
     /* Read input file */
     FILE *infile = fopen(input_file, "rb");
@@ -328,86 +544,136 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     
-    uint8_t *data = malloc(file_size);
+    /* Input plus an output buffer of the same size; when that does not
+     * fit the limit or RAM, encode in two streaming passes instead.
+     * Analysis only holds the input. */
+    uint64_t needed = analyze_mode ? (uint64_t)file_size : 2 * (uint64_t)file_size + 16;
+    if (!analyze_mode && (stream_mode || !memFits(needed) || exceedsMemory(needed))) {
+        size_t chunk = streamChunkSize();
+        if (verbose) fprintf(stderr, "Streaming encode, %zu-byte chunks\n", chunk);
+        
+        uint64_t compressed_size = 0;
+        uint16_t tree_size = 0;
+        int ok = encodeStream(infile, file_size, output_file, chunk, margin, &stats, &progress,
+                              &compressed_size, &tree_size);
+        fclose(infile);
+        if (ok) {
+            reportResults(&stats, stats_format, verbose, output_file, file_size,
+                          compressed_size, tree_size);
+        }
+        progressFree(&progress);
+        if (output_file != argv[argc-1]) memFree(output_file);
+        return ok && traceClose() ? 0 : 1;
+    }
+    
+    if (!memFits(needed)) {
+        fprintf(stderr, "Error: %s %ld bytes needs about %llu bytes, over the memory limit of %llu\n",
+                analyze_mode ? "Analyzing" : "Encoding", file_size, (unsigned long long)needed, (unsigned long long)memLimit());
+        fclose(infile);
+        return 1;
+    }
+    
+    uint8_t *data = memAlloc(file_size);
     if (!data) {
         fprintf(stderr, "Error: Cannot allocate memory for file (%ld bytes)\n", file_size);
         fclose(infile);
         return 1;
     }
     
-    if (verbose) showProgress("Reading", 0, file_size);
-    size_t bytes_read = fread(data, 1, file_size, infile);
-    if (bytes_read != file_size) {
+    progressBegin(&progress, "Reading", file_size);
+    statsBegin(&stats, "read");
+    size_t bytes_read = readChunked(infile, data, file_size, progress.enabled ? &progress.done : NULL);
+    if (bytes_read != (size_t)file_size) {
         fprintf(stderr, "Error: Could not read entire file\n");
-        free(data);
+        memFree(data);
         fclose(infile);
         return 1;
     }
     fclose(infile);
+    statsEnd(&stats, file_size, file_size);
+    progressEnd(&progress);
     
-    if (verbose) {
-        fprintf(stderr, "\rRead %ld bytes from '%s'\n", file_size, input_file);
-        showProgress("Analyzing", 0, file_size);
-    }
+    if (verbose) fprintf(stderr, "Read %ld bytes from '%s'\n", file_size, input_file);
     
     /* Build frequency table */
+    uint64_t totals[MAXN] = {0};
     uint32_t freq[MAXN];
-    buildFreqTable(data, file_size, freq);
+    statsBegin(&stats, "histogram");
+    countFreqTable(data, file_size, totals);
+    statsEnd(&stats, file_size, sizeof(freq));
+    if (!narrowFreqTable(totals, freq)) {
+        memFree(data);
+        return 1;
+    }
     
     /* Build Huffman tree */
+    statsBegin(&stats, "tree");
     Node *root = buildHuffmanTree(freq);
+    statsEnd(&stats, sizeof(freq), 0);
     if (!root) {
         fprintf(stderr, "Error: Failed to build Huffman tree\n");
-        free(data);
+        memFree(data);
         return 1;
     }
     
     /* Generate codes */
     CodeEntry codes[MAXN];
-    memset(codes, 0, sizeof(codes));
-    
-    if (root->left || root->right) {
-        generateCodes(root, codes, 0, 0);
-    } else {
-        /* Single symbol file */
-        codes[root->ch].code = malloc(1);
-        codes[root->ch].code[0] = 0;
-        codes[root->ch].len = 1;
+    statsBegin(&stats, "codes");
+    buildCodes(root, codes);
+    statsEnd(&stats, 0, sizeof(codes));
+    
+    if (analyze_mode) {
+        analyze(stdout, data, file_size, freq, codes, analyze_mode == 2);
+        progressFree(&progress);
+        freeCodes(codes);
+        memFree(data);
+        freeTree(root);
+        return traceClose() ? 0 : 1;
     }
     
-    if (verbose) showProgress("Compressing", 0, file_size);
-    
     /* Compress data */
-    BitBuffer *compressed = compress(data, file_size, codes);
+    progressBegin(&progress, "Compressing", file_size);
+    statsBegin(&stats, "encode");
+    BitBuffer *compressed = bitBufferInit(file_size + 16 < BITBUFFER_CHUNK ? file_size + 16 : BITBUFFER_CHUNK);
+    if (compressed && margin) bitBufferTrackMargin(compressed);
+    if (compressed && !compressAppend(compressed, data, file_size, codes)) {
+        bitBufferFree(compressed);
+        compressed = NULL;
+    }
     if (!compressed) {
         fprintf(stderr, "Error: Compression failed\n");
-        free(data);
+        memFree(data);
         freeTree(root);
         return 1;
     }
+    uint64_t compressed_size = bitBufferLength(compressed);
+    statsEnd(&stats, file_size, compressed_size);
+    progressEnd(&progress);
     
     /* Calculate checksum */
+    statsBegin(&stats, "crc");
     uint32_t checksum = crc32(data, file_size);
+    statsEnd(&stats, file_size, sizeof(checksum));
     
     /* Prepare header */
     HuffHeader header = {
         .magic = MAGIC_NUMBER,
         .version = VERSION,
         .original_size = file_size,
-        .compressed_size = compressed->size,
+        .compressed_size = compressed_size,
         .checksum = checksum,
         .tree_size = 0,  /* Will be updated after writing frequency table */
         .padding_bits = compressed->bits_used > 0 ? (8 - compressed->bits_used) : 0,
-        .reserved = 0
+        .margin_code = margin ? inPlaceMarginCode(&compressed->margin, file_size, compressed_size) : 0
     };
     
     /* Write compressed file */
+    statsBegin(&stats, "write");
     FILE *outfile = fopen(output_file, "wb");
     if (!outfile) {
         perror("Error opening output file");
-        free(data);
-        free(compressed->data);
-        free(compressed);
+        memFree(data);
+        bitBufferFree(compressed);
         freeTree(root);
         return 1;
     }
@@ -434,7 +700,13 @@ int main(int argc, char *argv[]) {
     fseek(outfile, 0, SEEK_END);
     
     /* Write compressed data */
-    if (fwrite(compressed->data, 1, compressed->size, outfile) != compressed->size) {
+    HUFF_PROBE2(io_write_submit, 0, compressed_size);
+    uint64_t t0 = traceEnabled() ? traceNow() : 0;
+    uint64_t written = 0;
+    int wrote = bitBufferWrite(compressed, outfile, 0, &written);
+    if (t0) traceSpan("write", "io", t0, traceNow(), written);
+    HUFF_PROBE2(io_write_complete, 0, written);
+    if (!wrote || written != compressed_size) {
         fprintf(stderr, "Error: Could not write compressed data\n");
         fclose(outfile);
         return 1;
@@ -442,26 +714,19 @@ int main(int argc, char *argv[]) {
     
     fclose(outfile);
     
-    /* Show results */
-    if (verbose) {
-        fprintf(stderr, "\rCompression complete!\n");
-        fprintf(stderr, "Original size:    %ld bytes\n", file_size);
-        fprintf(stderr, "Compressed size:  %zu bytes\n", compressed->size + sizeof(HuffHeader) + tree_size * sizeof(FreqEntry));
-        fprintf(stderr, "Compression ratio: %.2f%%\n", 
-                100.0 * (1.0 - (double)(compressed->size + sizeof(HuffHeader) + tree_size * sizeof(FreqEntry)) / file_size));
-        fprintf(stderr, "Output file: '%s'\n", output_file);
-    }
+    uint64_t total_out = compressed_size + sizeof(HuffHeader) + tree_size * sizeof(FreqEntry);
+    statsEnd(&stats, compressed_size, total_out);
+    
+    reportResults(&stats, stats_format, verbose, output_file, file_size, compressed_size, tree_size);
     
     /* Cleanup */
-    for (int i = 0; i < MAXN; i++) {
-        free(codes[i].code);
-    }
-    free(data);
-    free(compressed->data);
-    free(compressed);
+    progressFree(&progress);
+    freeCodes(codes);
+    memFree(data);
+    bitBufferFree(compressed);
     freeTree(root);
     
-    if (output_file != argv[argc-1]) free(output_file);
+    if (output_file != argv[argc-1]) memFree(output_file);
     
-    return 0;
+    return traceClose() ? 0 : 1;
 }
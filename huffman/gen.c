@@ -0,0 +1,97 @@
+/* gen.c - Synthetic Corpus Generator for Huffman Benchmarks and Tests */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#define HUFF_IMPLEMENTATION
+#define CORPUS_IMPLEMENTATION
+#include "huff.h"
+#include "corpus.h"
+
+static void usage(const char *prog) {
+    printf("Usage: %s [options] <kind> <size> <output_file|->\n", prog);
+    printf("Kinds:\n");
+    printf("  uniform      Uniform random bytes (256 active symbols)\n");
+    printf("  single       One repeated symbol\n");
+    printf("  geometric    P(k) ~ (1-skew)^k, default skew 0.3\n");
+    printf("  zipf         P(k) ~ 1/(k+1)^skew, default skew 1.0\n");
+    printf("  sparse       Binary, bits set with probability skew (default 0.05)\n");
+    printf("  compressed   Huffman-coded Zipf text\n");
+    printf("  fibonacci    Fibonacci frequencies (deepest tree for the size)\n");
+    printf("Options:\n");
+    printf("  -s, --seed N     Random seed (default 1)\n");
+    printf("  -k, --skew X     Distribution parameter\n");
+    printf("  -f, --force      Overwrite existing files\n");
+    printf("  -h, --help       Show this help\n");
+    printf("Size accepts K, M, G and T suffixes (powers of 1024).\n");
+}
+
+int main(int argc, char *argv[]) {
+    CorpusSpec spec = { .kind = CORPUS_UNIFORM, .seed = 1, .skew = 0 };
+    int force = 0;
+    const char *args[3];
+    int nargs = 0;
+
+    /* Parse command line arguments */
+    for (int i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--seed") == 0) && i + 1 < argc) {
+            spec.seed = strtoull(argv[++i], NULL, 0);
+        } else if ((strcmp(argv[i], "-k") == 0 || strcmp(argv[i], "--skew") == 0) && i + 1 < argc) {
+            spec.skew = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-f") == 0 || strcmp(argv[i], "--force") == 0) {
+            force = 1;
+        } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            usage(argv[0]);
+            return 0;
+        } else if (nargs < 3) {
+            args[nargs++] = argv[i];
+        }
+    }
+
+    if (nargs != 3) {
+        fprintf(stderr, "Error: Expected <kind> <size> <output_file>\n");
+        fprintf(stderr, "Use %s --help for usage information\n", argv[0]);
+        return 1;
+    }
+
+    if (!corpusParseKind(args[0], &spec.kind)) {
+        fprintf(stderr, "Error: Unknown corpus kind '%s'\n", args[0]);
+        return 1;
+    }
+
+    uint64_t size;
+    if (!memParseSize(args[1], &size)) {
+        fprintf(stderr, "Error: Invalid size '%s'\n", args[1]);
+        return 1;
+    }
+
+    FILE *out;
+    if (strcmp(args[2], "-") == 0) {
+        out = stdout;
+    } else {
+        struct stat st;
+        if (!force && stat(args[2], &st) == 0) {
+            fprintf(stderr, "Error: Output file '%s' already exists (use -f to overwrite)\n", args[2]);
+            return 1;
+        }
+        out = fopen(args[2], "wb");
+        if (!out) {
+            perror("Error opening output file");
+            return 1;
+        }
+    }
+
+    if (!corpusWrite(out, &spec, size)) {
+        fprintf(stderr, "Error: Could not write corpus\n");
+        if (out != stdout) fclose(out);
+        return 1;
+    }
+
+    if (out != stdout && fclose(out) != 0) {
+        perror("Error closing output file");
+        return 1;
+    }
+    return 0;
+}
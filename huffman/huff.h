@@ -0,0 +1,1503 @@
+/* huff.h - Single Header Huffman Coding Kernels
+ *
+ * Shared by enc, dec, bench and transcode so every tool times and runs the
+ * same code, down to the file format writers and the streaming decoder.
+ * The hot kernels (histogram, CRC, encode, decode) are bound once at startup
+ * to the best implementation for the host CPU; see cpu.h and HUFF_CPU.
+ *
+ * Every buffer is allocated through mem.h; release the results of
+ * decompress() and bitReaderInit() with memFree().
+ *
+ * Usage:
+ *   #define HUFF_IMPLEMENTATION
+ *   #include "huff.h"
+ */
+
+#ifndef HUFF_H
+#define HUFF_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#ifdef HUFF_IMPLEMENTATION
+#define PQUEUE_IMPLEMENTATION
+#define CPU_IMPLEMENTATION
+#define TRACE_IMPLEMENTATION
+#define MEM_IMPLEMENTATION
+#define PQ_MALLOC(size) memAlloc(size)
+#define PQ_FREE(ptr) memFree(ptr)
+#endif
+#include "mem.h"
+#include "pqueue.h"
+#include "cpu.h"
+#include "probes.h"
+#include "progress.h"
+#include "trace.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MAXN 256
+#define MAXCODE 64
+#define MAGIC_NUMBER 0x48554646  /* "HUFF" */
+#define VERSION 1
+#define BLOCK_SIZE 65536
+#define HUFF_TABLE_BITS_MIN 1
+#define HUFF_TABLE_BITS_MAX 13
+#define BITBUFFER_CHUNK (1 << 20)
+#define HUFF_IO_CHUNK (1 << 20)             /* bytes per fread/fwrite in readChunked() */
+#define HUFF_STAGE_SIZE 16384               /* decode staging for streaming stores */
+#define HUFF_STREAMING_MIN (64ull << 20)    /* HUFF_STORES_AUTO streams outputs this large */
+
+/* How decompress() writes its output */
+typedef enum {
+    HUFF_STORES_AUTO,       /* streaming from HUFF_STREAMING_MIN bytes of output up */
+    HUFF_STORES_CACHED,
+    HUFF_STORES_STREAMING
+} HuffStoreMode;
+
+/* Binary file format structures */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint64_t original_size;
+    uint64_t compressed_size;
+    uint32_t checksum;
+    uint16_t tree_size;
+    uint8_t padding_bits;
+    uint8_t margin_code;    /* in-place margin is 2^(code-1) bytes; 0 = not recorded */
+} __attribute__((packed)) HuffHeader;
+
+typedef struct {
+    uint8_t ch;
+    uint32_t freq;
+} __attribute__((packed)) FreqEntry;
+
+typedef struct {
+    uint8_t *code;
+    uint8_t len;
+} CodeEntry;
+
+typedef struct BitChunk {
+    struct BitChunk *next;
+    size_t size;
+    uint8_t data[];
+} BitChunk;
+
+/* Worst lead of output over input seen so far, for in-place decoding;
+ * kept up to date by the encoder once bitBufferTrackMargin() is called */
+typedef struct {
+    uint64_t symbols;
+    int64_t worst;
+} InPlaceMargin;
+
+/* Output is a rope of fixed-size chunks, so growing it never copies what
+ * is already written. data/size/capacity describe the chunk being
+ * filled; full chunks hang off head in order, and chunks that have been
+ * written out wait in pool for reuse. */
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+    uint8_t bit_buffer;
+    uint8_t bits_used;
+    BitChunk *current;
+    BitChunk *head, *tail;
+    BitChunk *pool;
+    size_t chunk_size;
+    uint64_t sealed;    /* bytes in the full chunks */
+    uint64_t drained;   /* bytes already written out by bitBufferWrite */
+    int track_margin;   /* see bitBufferTrackMargin() */
+    InPlaceMargin margin;
+} BitBuffer;
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+    uint8_t bit_buffer;
+    uint8_t bits_available;
+} BitReader;
+
+/* Code as an MSB-first integer, for the encode kernels */
+typedef struct {
+    uint64_t bits;
+    uint8_t len;
+} HuffCode;
+
+/* Lookup table over the next table_bits input bits: entry = symbol | length << 8.
+ * Length 0 marks a code longer than table_bits, decoded by walking the tree. */
+typedef struct {
+    int table_bits;
+    uint16_t *entries;
+    Node *root;
+} HuffDecodeTable;
+
+/* Decoder position, kept between calls so a stream can be decoded in
+ * pieces: window holds avail unconsumed bits taken from in[0..pos). */
+typedef struct {
+    uint64_t window;
+    int avail;
+    size_t pos;
+} HuffDecodeState;
+
+/* Incremental decoder over a caller-managed input buffer */
+typedef struct {
+    HuffDecodeTable table;
+    HuffDecodeState state;
+    Node *root;
+    int max_len;
+    size_t crc_slice;   /* nonzero: CRC each slice of output as it is decoded */
+    uint32_t checksum;  /* CRC of all output so far, see decoderEnableChecksum() */
+    int streaming;      /* stage output in L1 and stream it out, see setOutputStores() */
+} HuffDecoder;
+
+/* Streaming decode from a file: feeds a HuffDecoder from an input buffer
+ * refilled from fp, so memory use does not depend on the payload size */
+typedef struct {
+    HuffDecoder *dec;
+    FILE *fp;
+    uint8_t *in;
+    size_t cap;
+    size_t len;
+    size_t start;       /* bytes before it are consumed */
+    uint64_t unread;    /* payload bytes not yet read from fp */
+    uint64_t valid_bits;
+} HuffStreamDecoder;
+
+/* Hot kernels, bound once from cpuLevel() */
+typedef struct {
+    const char *name;
+    void (*histogram)(const uint8_t *data, size_t len, uint32_t freq[]);
+    uint32_t (*crc32)(uint32_t crc, const uint8_t *data, size_t len);
+    int (*encode)(BitBuffer *buf, const uint8_t *data, size_t len, const HuffCode table[]);
+    int (*decode)(const HuffDecodeTable *table, HuffDecodeState *state, const uint8_t *in,
+                  size_t in_len, uint64_t valid_bits, uint8_t *out, uint64_t count);
+} HuffKernels;
+
+/* Bit I/O Interface */
+BitBuffer *bitBufferInit(size_t initial_size);
+void bitBufferWriteBits(BitBuffer *buf, uint32_t bits, int count);
+void bitBufferFlush(BitBuffer *buf);
+void bitBufferFree(BitBuffer *buf);
+uint64_t bitBufferLength(const BitBuffer *buf);
+void bitBufferTrackMargin(BitBuffer *buf);
+int bitBufferWrite(BitBuffer *buf, FILE *fp, int keep_partial, uint64_t *written);
+uint8_t *bitBufferCoalesce(BitBuffer *buf);
+BitReader *bitReaderInit(const uint8_t *data, size_t size);
+int bitReaderReadBit(BitReader *reader);
+
+/* Checksum Interface */
+void init_crc32(void);
+uint32_t crc32(const uint8_t *data, size_t len);
+uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t len);
+
+/* Kernel Dispatch Interface */
+const HuffKernels *huffKernels(void);
+
+/* Coding Interface */
+void buildFreqTable(const uint8_t *data, size_t len, uint32_t freq[]);
+Node *buildHuffmanTree(uint32_t freq[]);
+void buildCodes(Node *root, CodeEntry codes[]);
+void freeCodes(CodeEntry codes[]);
+int buildDecodeTable(HuffDecodeTable *table, Node *root, int table_bits);
+int chooseTableBits(Node *root, uint64_t count);
+void setTableBits(int table_bits);
+void setOutputStores(HuffStoreMode mode);
+int parseOutputStores(const char *text, HuffStoreMode *mode);
+int decodeTableBits(Node *root, uint64_t original_size);
+void setProgressCounter(uint64_t *counter);
+void freeDecodeTable(HuffDecodeTable *table);
+BitBuffer *compress(const uint8_t *data, size_t len, CodeEntry codes[]);
+BitBuffer *compressAppend(BitBuffer *buf, const uint8_t *data, size_t len, CodeEntry codes[]);
+uint8_t *decompress(BitReader *reader, Node *root, uint64_t original_size, uint8_t padding_bits);
+int decoderInit(HuffDecoder *dec, Node *root, uint64_t original_size);
+size_t decoderInputBound(const HuffDecoder *dec, uint64_t count);
+int decoderRun(HuffDecoder *dec, const uint8_t *in, size_t in_len, uint64_t valid_bits,
+               uint8_t *out, uint64_t count);
+size_t decoderConsume(HuffDecoder *dec);
+void decoderEnableChecksum(HuffDecoder *dec);
+void decoderFree(HuffDecoder *dec);
+uint8_t inPlaceMarginCode(const InPlaceMargin *m, uint64_t original_size, uint64_t compressed_size);
+uint64_t inPlaceMargin(const HuffHeader *header);
+int decompressInPlace(uint8_t *buf, size_t buf_size, Node *root, const HuffHeader *header);
+int streamDecoderInit(HuffStreamDecoder *s, HuffDecoder *dec, FILE *fp, uint64_t payload,
+                      uint8_t padding_bits, uint64_t chunk);
+int streamDecoderFill(HuffStreamDecoder *s, uint64_t count, size_t *got);
+int streamDecoderRun(HuffStreamDecoder *s, uint8_t *out, uint64_t count, size_t *used);
+void streamDecoderFree(HuffStreamDecoder *s);
+
+/* File Interface */
+long getFileSize(const char *filename);
+size_t readChunked(FILE *fp, uint8_t *data, size_t size, uint64_t *progress);
+size_t writeChunked(FILE *fp, const uint8_t *data, size_t size, uint64_t *progress);
+int writeHeader(FILE *fp, const HuffHeader *header);
+uint16_t writeFreqTable(FILE *fp, const uint32_t freq[]);
+int readFreqTable(FILE *fp, uint32_t freq[], uint16_t tree_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* ============================================================================
+ * IMPLEMENTATION
+ * ============================================================================ */
+
+#ifdef HUFF_IMPLEMENTATION
+
+#include <sys/stat.h>
+
+/* Bit buffer operations for binary compression */
+static BitChunk *bitChunkAlloc(BitBuffer *buf, size_t capacity) {
+    if (buf->pool && capacity == buf->chunk_size) {
+        BitChunk *chunk = buf->pool;
+        buf->pool = chunk->next;
+        return chunk;
+    }
+    return memAlloc(sizeof(BitChunk) + capacity);
+}
+
+/* chunk_size is the capacity of every chunk; BITBUFFER_CHUNK suits large
+ * outputs, the expected size avoids a 1 MiB chunk for a small one */
+BitBuffer *bitBufferInit(size_t chunk_size) {
+    BitBuffer *buf = memCalloc(1, sizeof(BitBuffer));
+    if (!buf) return NULL;
+
+    buf->current = memAlloc(sizeof(BitChunk) + chunk_size);
+    if (!buf->current) {
+        memFree(buf);
+        return NULL;
+    }
+
+    buf->data = buf->current->data;
+    buf->capacity = chunk_size;
+    buf->chunk_size = chunk_size;
+    return buf;
+}
+
+/* Start a fresh chunk when the current one has no room for needed bytes.
+ * Returns 0, leaving the buffer as it was, if none can be had. */
+static int bitBufferEnsure(BitBuffer *buf, size_t needed) {
+    if (buf->size + needed <= buf->capacity) return 1;
+
+    size_t capacity = needed > buf->chunk_size ? needed : buf->chunk_size;
+    BitChunk *chunk = bitChunkAlloc(buf, capacity);
+    if (!chunk) {
+        fprintf(stderr, "Error: Cannot grow output buffer past %llu bytes\n",
+                (unsigned long long)bitBufferLength(buf));
+        return 0;
+    }
+
+    BitChunk *full = buf->current;
+    full->size = buf->size;
+    full->next = NULL;
+    if (buf->tail) buf->tail->next = full;
+    else buf->head = full;
+    buf->tail = full;
+    buf->sealed += full->size;
+
+    buf->current = chunk;
+    buf->data = chunk->data;
+    buf->size = 0;
+    buf->capacity = capacity;
+    return 1;
+}
+
+void bitBufferWriteBits(BitBuffer *buf, uint32_t bits, int count) {
+    for (int i = count - 1; i >= 0; i--) {
+        buf->bit_buffer = (buf->bit_buffer << 1) | ((bits >> i) & 1);
+        buf->bits_used++;
+
+        if (buf->bits_used == 8) {
+            if (!bitBufferEnsure(buf, 1)) return;
+            buf->data[buf->size++] = buf->bit_buffer;
+            buf->bit_buffer = 0;
+            buf->bits_used = 0;
+        }
+    }
+}
+
+void bitBufferFlush(BitBuffer *buf) {
+    if (buf->bits_used > 0) {
+        buf->bit_buffer <<= (8 - buf->bits_used);
+        if (!bitBufferEnsure(buf, 1)) return;
+        buf->data[buf->size++] = buf->bit_buffer;
+    }
+}
+
+static void bitChunkFreeList(BitChunk *chunk) {
+    while (chunk) {
+        BitChunk *next = chunk->next;
+        memFree(chunk);
+        chunk = next;
+    }
+}
+
+void bitBufferFree(BitBuffer *buf) {
+    if (buf) {
+        bitChunkFreeList(buf->head);
+        bitChunkFreeList(buf->pool);
+        memFree(buf->current);
+        memFree(buf);
+    }
+}
+
+/* Bytes written so far, including a partial last byte */
+uint64_t bitBufferLength(const BitBuffer *buf) {
+    return buf->sealed + buf->size;
+}
+
+/* Have the encoder keep buf->margin up to date for inPlaceMarginCode().
+ * Call before encoding into buf; it costs a few operations per symbol,
+ * so the encode kernels only do it when asked. */
+void bitBufferTrackMargin(BitBuffer *buf) {
+    buf->track_margin = 1;
+}
+
+/* Write every chunk to fp with writev(), in order, and recycle the full
+ * ones. With keep_partial, a partial last byte stays behind for the next
+ * compressAppend(). fp is flushed first and written through its file
+ * descriptor, so fseek() it before any further stdio writes. Returns 0
+ * on a write error. */
+int bitBufferWrite(BitBuffer *buf, FILE *fp, int keep_partial, uint64_t *written) {
+    size_t tail = buf->size - (keep_partial && buf->bits_used && buf->size ? 1 : 0);
+    struct iovec iov[64];
+    int fd = fileno(fp);
+    uint64_t total = 0;
+    int ok = fflush(fp) == 0;
+
+    BitChunk *chunk = buf->head;
+    int last = 0;
+    while (ok && !last) {
+        int n = 0;
+        for (; chunk && n < 64; chunk = chunk->next) {
+            iov[n].iov_base = chunk->data;
+            iov[n++].iov_len = chunk->size;
+        }
+        if (!chunk && n < 64) {
+            iov[n].iov_base = buf->data;
+            iov[n++].iov_len = tail;
+            last = 1;
+        }
+
+        /* writev() may stop early; resume from the first unwritten byte */
+        int first = 0;
+        while (first < n) {
+            ssize_t put = writev(fd, iov + first, n - first);
+            if (put <= 0) {
+                ok = 0;
+                break;
+            }
+            total += put;
+            while (first < n && (size_t)put >= iov[first].iov_len) {
+                put -= iov[first++].iov_len;
+            }
+            if (first < n) {
+                iov[first].iov_base = (uint8_t *)iov[first].iov_base + put;
+                iov[first].iov_len -= put;
+            }
+        }
+    }
+    if (written) *written = total;
+    if (!ok) return 0;
+    buf->drained += total;
+
+    if (buf->tail) {
+        buf->tail->next = buf->pool;
+        buf->pool = buf->head;
+        buf->head = buf->tail = NULL;
+    }
+    buf->sealed = 0;
+    memmove(buf->data, buf->data + tail, buf->size - tail);
+    buf->size -= tail;
+    return 1;
+}
+
+/* Gather the rope into one contiguous block (one copy; nothing to do for
+ * a single chunk) and return it */
+uint8_t *bitBufferCoalesce(BitBuffer *buf) {
+    if (!buf->head) return buf->data;
+
+    size_t length = bitBufferLength(buf);
+    BitChunk *whole = memAlloc(sizeof(BitChunk) + length);
+    if (!whole) return NULL;
+
+    size_t at = 0;
+    for (BitChunk *chunk = buf->head; chunk; chunk = chunk->next) {
+        memcpy(whole->data + at, chunk->data, chunk->size);
+        at += chunk->size;
+    }
+    memcpy(whole->data + at, buf->data, buf->size);
+
+    bitChunkFreeList(buf->head);
+    bitChunkFreeList(buf->pool);
+    memFree(buf->current);
+    buf->head = buf->tail = buf->pool = NULL;
+    buf->sealed = 0;
+    buf->current = whole;
+    buf->data = whole->data;
+    buf->size = buf->capacity = length;
+    return buf->data;
+}
+
+/* Bit reader for binary decompression */
+BitReader *bitReaderInit(const uint8_t *data, size_t size) {
+    BitReader *reader = memAlloc(sizeof(BitReader));
+    if (!reader) return NULL;
+
+    reader->data = data;
+    reader->size = size;
+    reader->pos = 0;
+    reader->bit_buffer = 0;
+    reader->bits_available = 0;
+    return reader;
+}
+
+int bitReaderReadBit(BitReader *reader) {
+    if (reader->bits_available == 0) {
+        if (reader->pos >= reader->size) return -1;
+
+        reader->bit_buffer = reader->data[reader->pos++];
+        reader->bits_available = 8;
+    }
+
+    int bit = (reader->bit_buffer >> 7) & 1;
+    reader->bit_buffer <<= 1;
+    reader->bits_available--;
+    return bit;
+}
+
+/* Fast CRC32 checksum: slicing-by-8 tables, table[0] is the classic one */
+static uint32_t crc32_table[8][256];
+static int crc32_initialized = 0;
+
+void init_crc32(void) {
+    if (crc32_initialized) return;
+
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int j = 0; j < 8; j++) {
+            if (crc & 1) {
+                crc = (crc >> 1) ^ 0xEDB88320;
+            } else {
+                crc >>= 1;
+            }
+        }
+        crc32_table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int k = 1; k < 8; k++) {
+            uint32_t prev = crc32_table[k - 1][i];
+            crc32_table[k][i] = (prev >> 8) ^ crc32_table[0][prev & 0xFF];
+        }
+    }
+    crc32_initialized = 1;
+}
+
+static uint32_t crc32Bytes(uint32_t crc, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        crc = crc32_table[0][(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+/* Generic kernel: eight bytes per step through the sliced tables */
+static uint32_t crc32Slice8(uint32_t crc, const uint8_t *data, size_t len) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while (len >= 8) {
+        uint32_t one, two;
+        memcpy(&one, data, 4);
+        memcpy(&two, data + 4, 4);
+        one ^= crc;
+        crc = crc32_table[7][one & 0xFF] ^ crc32_table[6][(one >> 8) & 0xFF] ^
+              crc32_table[5][(one >> 16) & 0xFF] ^ crc32_table[4][one >> 24] ^
+              crc32_table[3][two & 0xFF] ^ crc32_table[2][(two >> 8) & 0xFF] ^
+              crc32_table[1][(two >> 16) & 0xFF] ^ crc32_table[0][two >> 24];
+        data += 8;
+        len -= 8;
+    }
+#endif
+    return crc32Bytes(crc, data, len);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+/* SSE4.2 kernel: fold 64 bytes per step with carry-less multiplies, then
+ * Barrett-reduce (Gopal et al., "Fast CRC Computation for Generic
+ * Polynomials Using PCLMULQDQ", constants for the reflected 0xEDB88320). */
+__attribute__((target("sse4.2,pclmul")))
+static uint32_t crc32Pclmul(uint32_t crc, const uint8_t *data, size_t len) {
+    static const uint64_t k1k2[2] __attribute__((aligned(16))) = { 0x0154442bd4, 0x01c6e41596 };
+    static const uint64_t k3k4[2] __attribute__((aligned(16))) = { 0x01751997d0, 0x00ccaa009e };
+    static const uint64_t k5k0[2] __attribute__((aligned(16))) = { 0x0163cd6124, 0x0000000000 };
+    static const uint64_t poly[2] __attribute__((aligned(16))) = { 0x01db710641, 0x01f7011641 };
+
+    if (len < 64) return crc32Slice8(crc, data, len);
+
+    size_t tail = len & 15;
+    len -= tail;
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128((const __m128i *)(data + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *)(data + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *)(data + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *)(data + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+    x0 = _mm_load_si128((const __m128i *)k1k2);
+    data += 64;
+    len -= 64;
+
+    /* Parallel fold blocks of 64 */
+    while (len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        y5 = _mm_loadu_si128((const __m128i *)(data + 0x00));
+        y6 = _mm_loadu_si128((const __m128i *)(data + 0x10));
+        y7 = _mm_loadu_si128((const __m128i *)(data + 0x20));
+        y8 = _mm_loadu_si128((const __m128i *)(data + 0x30));
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+        data += 64;
+        len -= 64;
+    }
+
+    /* Fold into 128 bits */
+    x0 = _mm_load_si128((const __m128i *)k3k4);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    /* Single fold blocks of 16 */
+    while (len >= 16) {
+        x2 = _mm_loadu_si128((const __m128i *)data);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        data += 16;
+        len -= 16;
+    }
+
+    /* Fold 128 bits to 64 */
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = _mm_loadl_epi64((const __m128i *)k5k0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Barrett reduce to 32 bits */
+    x0 = _mm_load_si128((const __m128i *)poly);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    crc = (uint32_t)_mm_extract_epi32(x1, 1);
+
+    return crc32Slice8(crc, data, tail);
+}
+#endif
+
+/* Continue a CRC: pass 0 to start, then the previous result */
+uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t len) {
+    if (!crc32_initialized) init_crc32();
+    HUFF_PROBE1(crc_start, len);
+    crc = huffKernels()->crc32(crc ^ 0xFFFFFFFF, data, len) ^ 0xFFFFFFFF;
+    HUFF_PROBE2(crc_done, len, crc);
+    return crc;
+}
+
+uint32_t crc32(const uint8_t *data, size_t len) {
+    return crc32Update(0, data, len);
+}
+
+/* Optimized frequency counting: four sub-histograms break the
+ * store-to-load dependency on runs of the same byte */
+static void histogramGeneric(const uint8_t *data, size_t len, uint32_t freq[]) {
+    uint32_t sub[4][MAXN];
+    memset(sub, 0, sizeof(sub));
+
+    size_t i = 0;
+    for (; i + 4 <= len; i += 4) {
+        sub[0][data[i]]++;
+        sub[1][data[i + 1]]++;
+        sub[2][data[i + 2]]++;
+        sub[3][data[i + 3]]++;
+    }
+    for (; i < len; i++) sub[0][data[i]]++;
+
+    for (int s = 0; s < MAXN; s++) {
+        freq[s] = sub[0][s] + sub[1][s] + sub[2][s] + sub[3][s];
+    }
+}
+
+void buildFreqTable(const uint8_t *data, size_t len, uint32_t freq[]) {
+    huffKernels()->histogram(data, len, freq);
+}
+
+/* Build canonical Huffman tree */
+Node *buildHuffmanTree(uint32_t freq[]) {
+    PQ *pq = PQinit(MAXN);
+    if (!pq) return NULL;
+
+    int symbols = 0;
+    for (int i = 0; i < MAXN; i++) {
+        if (freq[i] > 0) {
+            PQinsert(pq, newNode(i, freq[i], NULL, NULL));
+            symbols++;
+        }
+    }
+
+    if (symbols == 0) {
+        PQfree(pq);
+        return NULL;
+    }
+
+    if (symbols == 1) {
+        Node *single = PQdelmin(pq);
+        PQfree(pq);
+        return single;
+    }
+
+    while (symbols > 1) {
+        Node *left = PQdelmin(pq);
+        Node *right = PQdelmin(pq);
+        Node *merged = newNode(0, left->freq + right->freq, left, right);
+        PQinsert(pq, merged);
+        symbols--;
+    }
+
+    Node *root = PQdelmin(pq);
+    PQfree(pq);
+    return root;
+}
+
+/* Generate binary codes */
+static void generateCodes(Node *root, CodeEntry codes[], uint64_t code, int depth) {
+    if (!root) return;
+
+    if (!root->left && !root->right) {
+        codes[root->ch].code = memCalloc((depth + 7) / 8, 1);  /* Use calloc to zero-initialize */
+        codes[root->ch].len = depth;
+
+        /* Pack bits efficiently */
+        for (int i = 0; i < depth; i++) {
+            if ((code >> (depth - 1 - i)) & 1) {
+                codes[root->ch].code[i / 8] |= (1 << (7 - (i % 8)));
+            }
+        }
+        return;
+    }
+
+    if (root->left) {
+        generateCodes(root->left, codes, code << 1, depth + 1);
+    }
+    if (root->right) {
+        generateCodes(root->right, codes, (code << 1) | 1, depth + 1);
+    }
+}
+
+/* Generate codes for every leaf, including the single symbol case */
+void buildCodes(Node *root, CodeEntry codes[]) {
+    memset(codes, 0, MAXN * sizeof(CodeEntry));
+    HUFF_PROBE1(table_build_start, 0);
+
+    if (root->left || root->right) {
+        generateCodes(root, codes, 0, 0);
+    } else {
+        /* Single symbol file */
+        codes[root->ch].code = memAlloc(1);
+        codes[root->ch].code[0] = 0;
+        codes[root->ch].len = 1;
+    }
+    HUFF_PROBE2(table_build_done, 0, MAXN);
+}
+
+void freeCodes(CodeEntry codes[]) {
+    for (int i = 0; i < MAXN; i++) {
+        memFree(codes[i].code);
+        codes[i].code = NULL;
+    }
+}
+
+/* Build the decode lookup table from the tree */
+static void fillDecodeTable(HuffDecodeTable *table, Node *node, uint32_t code, int depth) {
+    if (!node) return;
+
+    if (!node->left && !node->right) {
+        int shift = table->table_bits - depth;
+        uint32_t first = code << shift;
+        for (uint32_t i = 0; i < (1u << shift); i++) {
+            table->entries[first + i] = node->ch | (uint16_t)(depth << 8);
+        }
+        return;
+    }
+
+    /* Codes longer than the table stay 0 and take the tree walk */
+    if (depth == table->table_bits) return;
+
+    fillDecodeTable(table, node->left, code << 1, depth + 1);
+    fillDecodeTable(table, node->right, (code << 1) | 1, depth + 1);
+}
+
+int buildDecodeTable(HuffDecodeTable *table, Node *root, int table_bits) {
+    table->table_bits = table_bits;
+    table->root = root;
+    HUFF_PROBE1(table_build_start, table_bits);
+    uint64_t t0 = traceEnabled() ? traceNow() : 0;
+    table->entries = memCalloc((size_t)1 << table_bits, sizeof(uint16_t));
+    if (!table->entries) return 0;
+
+    fillDecodeTable(table, root, 0, 0);
+    if (t0) traceSpan("table build", "table", t0, traceNow(), ((size_t)1 << table_bits) * sizeof(uint16_t));
+    HUFF_PROBE2(table_build_done, table_bits, (size_t)1 << table_bits);
+    return 1;
+}
+
+void freeDecodeTable(HuffDecodeTable *table) {
+    memFree(table->entries);
+    table->entries = NULL;
+}
+
+/* Symbols decoded per code length, from the leaf frequencies */
+static void depthHistogram(Node *node, int depth, uint64_t hist[MAXCODE + 1]) {
+    if (!node) return;
+    if (!node->left && !node->right) {
+        hist[depth < MAXCODE ? depth : MAXCODE] += node->freq;
+        return;
+    }
+    depthHistogram(node->left, depth + 1, hist);
+    depthHistogram(node->right, depth + 1, hist);
+}
+
+/* Cost model for the decode table width, in units of one table-hit
+ * symbol: codes longer than the table take a tree walk (about eight
+ * times slower), every entry costs about half a symbol to fill, and the
+ * table must leave half of L1 for the input and output streams. */
+#define TABLE_WALK_COST 8.0
+#define TABLE_FILL_COST 0.5
+
+int chooseTableBits(Node *root, uint64_t count) {
+    uint64_t hist[MAXCODE + 1] = {0};
+    depthHistogram(root, 0, hist);
+
+    int max_len = 0;
+    uint64_t total = 0;
+    for (int l = 0; l <= MAXCODE; l++) {
+        if (hist[l]) max_len = l;
+        total += hist[l];
+    }
+    if (max_len < HUFF_TABLE_BITS_MIN) return HUFF_TABLE_BITS_MIN;
+
+    size_t budget = cpuL1DataCacheSize() / 2;
+    int best = HUFF_TABLE_BITS_MIN;
+    double best_cost = -1;
+    uint64_t slow = total;
+
+    for (int bits = HUFF_TABLE_BITS_MIN; bits <= HUFF_TABLE_BITS_MAX && bits <= max_len; bits++) {
+        slow -= hist[bits];
+        if (bits > HUFF_TABLE_BITS_MIN && ((size_t)1 << bits) * sizeof(uint16_t) > budget) break;
+
+        double slow_frac = total ? (double)slow / total : 0.0;
+        double cost = count * slow_frac * TABLE_WALK_COST + ((size_t)1 << bits) * TABLE_FILL_COST;
+        if (best_cost < 0 || cost < best_cost) {
+            best_cost = cost;
+            best = bits;
+        }
+    }
+    return best;
+}
+
+static int pinned_table_bits = 0;
+
+/* Pin the decode table width (0 restores the cost model) */
+void setTableBits(int table_bits) {
+    pinned_table_bits = table_bits;
+}
+
+/* Table width the decoders use for this tree; 0 when there is no table
+ * because the tree is a single symbol */
+int decodeTableBits(Node *root, uint64_t original_size) {
+    if (!root || (!root->left && !root->right)) return 0;
+    return pinned_table_bits ? pinned_table_bits : chooseTableBits(root, original_size);
+}
+
+static HuffStoreMode output_stores = HUFF_STORES_AUTO;
+
+/* How decoders set up after this write their output; see decoderStaged() */
+void setOutputStores(HuffStoreMode mode) {
+    output_stores = mode;
+}
+
+/* "auto", "cached" or "streaming" */
+int parseOutputStores(const char *text, HuffStoreMode *mode) {
+    if (strcmp(text, "auto") == 0) *mode = HUFF_STORES_AUTO;
+    else if (strcmp(text, "cached") == 0) *mode = HUFF_STORES_CACHED;
+    else if (strcmp(text, "streaming") == 0) *mode = HUFF_STORES_STREAMING;
+    else return 0;
+    return 1;
+}
+
+/* Bytes finished by encode/decode, added once per BLOCK_SIZE with progressAdd() */
+static uint64_t *progress_counter = NULL;
+
+void setProgressCounter(uint64_t *counter) {
+    progress_counter = counter;
+}
+
+static inline __attribute__((always_inline)) void storeBE32(uint8_t *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static inline __attribute__((always_inline)) uint64_t loadBE64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+/* Encode: codes are appended to a 64-bit accumulator and written out 32
+ * bits at a time. Fewer than 32 bits are pending between symbols, so any
+ * code up to 32 bits fits; longer ones (deep trees only) go in two parts.
+ * Progress is published once per BLOCK_SIZE input bytes. A buffer left
+ * by an earlier call is continued from its partial last byte, so encoding
+ * in pieces gives the same stream as one call over the whole input.
+ * track is a constant at each call site: the copy with it set also keeps
+ * buf->margin current, the other carries no extra work. */
+static inline __attribute__((always_inline))
+int encodeImpl(BitBuffer *buf, const uint8_t *data, size_t len, const HuffCode table[],
+               const int track) {
+    uint64_t *counter = progress_counter;
+    int tracing = traceEnabled();
+    uint64_t acc = 0;
+    int pending = 0;
+
+    if (buf->bits_used > 0 && buf->size > 0) {
+        pending = buf->bits_used;
+        acc = buf->data[--buf->size] >> (8 - pending);
+    }
+
+    /* In-place margin (track only): before symbol i the whole bytes
+     * emitted are drained + sealed + size + pending / 8, so the lead of
+     * symbols over bytes is lead_base + i - size - pending / 8 */
+    int64_t worst = buf->margin.worst;
+    int64_t lead_base = (int64_t)buf->margin.symbols - (int64_t)(buf->drained + buf->sealed);
+
+    for (size_t base = 0; base < len; base += BLOCK_SIZE) {
+        size_t end = len - base < BLOCK_SIZE ? len : base + BLOCK_SIZE;
+        HUFF_PROBE2(encode_block_start, base, end - base);
+        uint64_t t0 = tracing ? traceNow() : 0;
+        for (size_t i = base; i < end; i++) {
+            const HuffCode *c = &table[data[i]];
+            if (c->len == 0) {
+                /* This character has no code - should not happen */
+                fprintf(stderr, "Error: No code for character %d\n", data[i]);
+                return 0;
+            }
+
+            if (track) {
+                int64_t lead = lead_base + (int64_t)i - (int64_t)(buf->size + (pending >> 3));
+                worst = lead > worst ? lead : worst;
+            }
+
+            if (buf->size + 16 > buf->capacity) {
+                if (!bitBufferEnsure(buf, 16)) return 0;
+                if (track) lead_base = (int64_t)buf->margin.symbols - (int64_t)(buf->drained + buf->sealed);
+            }
+
+            if (c->len > 32) {
+                int high = c->len - 32;
+                acc = (acc << high) | (c->bits >> 32);
+                pending += high;
+                if (pending >= 32) {
+                    pending -= 32;
+                    storeBE32(buf->data + buf->size, (uint32_t)(acc >> pending));
+                    buf->size += 4;
+                }
+                acc = (acc << 32) | (uint32_t)c->bits;
+                pending += 32;
+            } else {
+                acc = (acc << c->len) | c->bits;
+                pending += c->len;
+            }
+
+            if (pending >= 32) {
+                pending -= 32;
+                storeBE32(buf->data + buf->size, (uint32_t)(acc >> pending));
+                buf->size += 4;
+            }
+        }
+        progressAdd(counter, end - base);
+        if (tracing) traceSpan("encode", "block", t0, traceNow(), end - base);
+        HUFF_PROBE3(encode_block_done, base, end - base, bitBufferLength(buf));
+    }
+
+    if (!bitBufferEnsure(buf, 8)) return 0;
+    while (pending >= 8) {
+        pending -= 8;
+        buf->data[buf->size++] = (uint8_t)(acc >> pending);
+    }
+    if (pending > 0) {
+        buf->data[buf->size++] = (uint8_t)(acc << (8 - pending));
+    }
+
+    /* Match bitBufferFlush: bits_used keeps the count in the last byte */
+    buf->bit_buffer = 0;
+    buf->bits_used = pending;
+    if (track) {
+        buf->margin.symbols += len;
+        buf->margin.worst = worst;
+    }
+    return 1;
+}
+
+/* Decode: a left-aligned 64-bit window refilled eight bytes at a time,
+ * one table lookup per symbol. Bits past the end read as zero; whether
+ * they were really needed is checked against valid_bits at the end, so
+ * a caller decoding in pieces must supply enough input for count symbols
+ * plus eight bytes of lookahead (decoderInputBound) until the real end.
+ * Progress is published once per BLOCK_SIZE output bytes. */
+static inline __attribute__((always_inline))
+int decodeImpl(const HuffDecodeTable *table, HuffDecodeState *state, const uint8_t *in,
+               size_t in_len, uint64_t valid_bits, uint8_t *out, uint64_t count) {
+    const uint16_t *entries = table->entries;
+    const int bits = table->table_bits;
+    uint64_t *counter = progress_counter;
+    int tracing = traceEnabled();
+    uint64_t window = state->window;
+    int avail = state->avail;
+    size_t pos = state->pos;
+
+    for (uint64_t base = 0; base < count; base += BLOCK_SIZE) {
+        uint64_t end = count - base < BLOCK_SIZE ? count : base + BLOCK_SIZE;
+        HUFF_PROBE2(decode_block_start, base, end - base);
+        uint64_t t0 = tracing ? traceNow() : 0;
+        for (uint64_t n = base; n < end; n++) {
+            if (avail < 56) {
+                if (pos + 8 <= in_len) {
+                    window |= loadBE64(in + pos) >> avail;
+                    int k = (63 - avail) >> 3;
+                    pos += k;
+                    avail += k * 8;
+                } else {
+                    while (avail <= 56) {
+                        uint64_t byte = pos < in_len ? in[pos] : 0;
+                        window |= byte << (56 - avail);
+                        pos++;
+                        avail += 8;
+                    }
+                    if (pos > in_len + 16) {
+                        fprintf(stderr, "Unexpected end of data during decompression\n");
+                        return 0;
+                    }
+                }
+            }
+
+            uint16_t e = entries[window >> (64 - bits)];
+            int len = e >> 8;
+            if (len) {
+                out[n] = (uint8_t)e;
+                window <<= len;
+                avail -= len;
+                continue;
+            }
+
+            /* Long code: walk the tree, refilling bit by bit if needed */
+            Node *node = table->root;
+            while (node->left || node->right) {
+                if (avail == 0) {
+                    window = (uint64_t)(pos < in_len ? in[pos] : 0) << 56;
+                    pos++;
+                    avail = 8;
+                }
+                node = (window >> 63) ? node->right : node->left;
+                window <<= 1;
+                avail--;
+                if (!node) {
+                    fprintf(stderr, "Invalid path in Huffman tree\n");
+                    return 0;
+                }
+            }
+            out[n] = node->ch;
+        }
+        progressAdd(counter, end - base);
+        if (tracing) traceSpan("decode", "block", t0, traceNow(), end - base);
+        HUFF_PROBE3(decode_block_done, base, end - base, pos);
+    }
+
+    /* Signed: a resumed window may still hold bits from before in[0] */
+    if ((int64_t)pos * 8 - avail > (int64_t)valid_bits) {
+        fprintf(stderr, "Unexpected end of data during decompression\n");
+        return 0;
+    }
+
+    state->window = window;
+    state->avail = avail;
+    state->pos = pos;
+    return 1;
+}
+
+static int encodeGeneric(BitBuffer *buf, const uint8_t *data, size_t len, const HuffCode table[]) {
+    return buf->track_margin ? encodeImpl(buf, data, len, table, 1)
+                             : encodeImpl(buf, data, len, table, 0);
+}
+
+static int decodeGeneric(const HuffDecodeTable *table, HuffDecodeState *state, const uint8_t *in,
+                         size_t in_len, uint64_t valid_bits, uint8_t *out, uint64_t count) {
+    return decodeImpl(table, state, in, in_len, valid_bits, out, count);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/* Same kernels compiled for BMI2: variable shifts become SHLX/SHRX and
+ * the window arithmetic no longer serializes on the flags register. */
+__attribute__((target("bmi,bmi2,lzcnt")))
+static int encodeBmi2(BitBuffer *buf, const uint8_t *data, size_t len, const HuffCode table[]) {
+    return buf->track_margin ? encodeImpl(buf, data, len, table, 1)
+                             : encodeImpl(buf, data, len, table, 0);
+}
+
+__attribute__((target("bmi,bmi2,lzcnt")))
+static int decodeBmi2(const HuffDecodeTable *table, HuffDecodeState *state, const uint8_t *in,
+                      size_t in_len, uint64_t valid_bits, uint8_t *out, uint64_t count) {
+    return decodeImpl(table, state, in, in_len, valid_bits, out, count);
+}
+#endif
+
+static HuffKernels huff_kernels;
+
+/* Bind every kernel slot to the best implementation for cpuLevel().
+ * AVX-512 hosts currently share the AVX2/BMI2 kernels. */
+static void bindKernels(void) {
+    CpuLevel level = cpuLevel();
+
+    huff_kernels.name = cpuLevelName(level);
+    huff_kernels.histogram = histogramGeneric;
+    huff_kernels.crc32 = crc32Slice8;
+    huff_kernels.encode = encodeGeneric;
+    huff_kernels.decode = decodeGeneric;
+
+#if defined(__x86_64__) || defined(__i386__)
+    if (level >= CPU_SSE42) {
+        huff_kernels.crc32 = crc32Pclmul;
+    }
+    if (level >= CPU_AVX2) {
+        huff_kernels.encode = encodeBmi2;
+        huff_kernels.decode = decodeBmi2;
+    }
+#endif
+}
+
+__attribute__((constructor))
+static void huffKernelsInit(void) {
+    bindKernels();
+}
+
+const HuffKernels *huffKernels(void) {
+    if (!huff_kernels.name) bindKernels();
+    return &huff_kernels;
+}
+
+/* Compress data using generated codes */
+BitBuffer *compress(const uint8_t *data, size_t len, CodeEntry codes[]) {
+    BitBuffer *buf = bitBufferInit(len + 16 < BITBUFFER_CHUNK ? len + 16 : BITBUFFER_CHUNK);
+    if (!buf) return NULL;
+
+    if (!compressAppend(buf, data, len, codes)) {
+        bitBufferFree(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+/* Encode more input onto the end of buf (see encodeImpl); buf is kept,
+ * with whatever it held before, when NULL is returned */
+BitBuffer *compressAppend(BitBuffer *buf, const uint8_t *data, size_t len, CodeEntry codes[]) {
+    HuffCode table[MAXN];
+    for (int s = 0; s < MAXN; s++) {
+        table[s].len = codes[s].len;
+        table[s].bits = 0;
+        for (int bit = 0; bit < codes[s].len; bit++) {
+            table[s].bits = (table[s].bits << 1) | ((codes[s].code[bit / 8] >> (7 - bit % 8)) & 1);
+        }
+    }
+
+    if (!huffKernels()->encode(buf, data, len, table)) return NULL;
+    return buf;
+}
+
+/* Copy with non-temporal stores: the destination goes straight to
+ * memory instead of evicting the decode table and input from cache.
+ * Callers sfence once when done. */
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+static void streamCopy(uint8_t *dst, const uint8_t *src, size_t len) {
+    while (len > 0 && ((uintptr_t)dst & 15)) {
+        *dst++ = *src++;
+        len--;
+    }
+    for (; len >= 64; len -= 64, src += 64, dst += 64) {
+        __m128i a = _mm_loadu_si128((const __m128i *)src);
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *)(src + 32));
+        __m128i d = _mm_loadu_si128((const __m128i *)(src + 48));
+        _mm_stream_si128((__m128i *)dst, a);
+        _mm_stream_si128((__m128i *)(dst + 16), b);
+        _mm_stream_si128((__m128i *)(dst + 32), c);
+        _mm_stream_si128((__m128i *)(dst + 48), d);
+    }
+    memcpy(dst, src, len);
+}
+
+static void streamFence(void) {
+    _mm_sfence();
+}
+#else
+static void streamCopy(uint8_t *dst, const uint8_t *src, size_t len) {
+    memcpy(dst, src, len);
+}
+
+static void streamFence(void) {
+}
+#endif
+
+/* Fast decompression using the lookup table */
+uint8_t *decompress(BitReader *reader, Node *root, uint64_t original_size, uint8_t padding_bits) {
+    if (!reader || !root || original_size == 0) return NULL;
+
+    uint8_t *output = memAlloc(original_size);
+    if (!output) return NULL;
+
+    HuffDecoder dec;
+    uint64_t valid_bits = (uint64_t)reader->size * 8 - padding_bits;
+    int ok = decoderInit(&dec, root, original_size) &&
+             decoderRun(&dec, reader->data, reader->size, valid_bits, output, original_size);
+    decoderFree(&dec);
+
+    if (!ok) {
+        memFree(output);
+        return NULL;
+    }
+    return output;
+}
+
+static int treeDepth(Node *node) {
+    if (!node || (!node->left && !node->right)) return 0;
+    int l = treeDepth(node->left);
+    int r = treeDepth(node->right);
+    return 1 + (l > r ? l : r);
+}
+
+/* Incremental decoding, for output that does not fit in memory:
+ *
+ *   decoderInit(&dec, root, original_size);
+ *   while (symbols remain) {
+ *       have at least decoderInputBound(&dec, n) bytes in buf, or all that is left
+ *       decoderRun(&dec, buf, len, valid_bits_from_buf, out, n);
+ *       drop decoderConsume(&dec) bytes from the front of buf
+ *   }
+ *   decoderFree(&dec);
+ */
+int decoderInit(HuffDecoder *dec, Node *root, uint64_t original_size) {
+    memset(dec, 0, sizeof(HuffDecoder));
+    if (!root) return 0;
+
+    dec->root = root;
+    dec->max_len = treeDepth(root);
+    if (!root->left && !root->right) return 1;
+
+    dec->streaming = output_stores == HUFF_STORES_STREAMING ||
+                     (output_stores == HUFF_STORES_AUTO && original_size >= HUFF_STREAMING_MIN);
+
+    return buildDecodeTable(&dec->table, root, decodeTableBits(root, original_size));
+}
+
+/* Input bytes, from the start of the caller's buffer, that decoding count
+ * more symbols may read */
+size_t decoderInputBound(const HuffDecoder *dec, uint64_t count) {
+    return dec->state.pos + (count * dec->max_len + 7) / 8 + 16;
+}
+
+static int decoderDecode(HuffDecoder *dec, const uint8_t *in, size_t in_len, uint64_t valid_bits,
+                         uint8_t *out, uint64_t count) {
+    if (!dec->table.entries) {
+        memset(out, dec->root->ch, count);
+        progressAdd(progress_counter, count);
+        return 1;
+    }
+    return huffKernels()->decode(&dec->table, &dec->state, in, in_len, valid_bits, out, count);
+}
+
+/* Streaming stores: decode a slice at a time into a stack buffer that
+ * stays in L1, CRC it there, then stream it to its place in out, so
+ * output of many GiB does not evict the decode table and input */
+static int decoderStaged(HuffDecoder *dec, const uint8_t *in, size_t in_len, uint64_t valid_bits,
+                         uint8_t *out, uint64_t count) {
+    uint8_t stage[HUFF_STAGE_SIZE] __attribute__((aligned(64)));
+    int ok = 1;
+
+    for (uint64_t done = 0; ok && done < count; done += HUFF_STAGE_SIZE) {
+        size_t n = count - done < HUFF_STAGE_SIZE ? count - done : HUFF_STAGE_SIZE;
+        ok = decoderDecode(dec, in, in_len, valid_bits, stage, n);
+        if (!ok) break;
+        if (dec->crc_slice) dec->checksum = crc32Update(dec->checksum, stage, n);
+        streamCopy(out + done, stage, n);
+    }
+    streamFence();
+    return ok;
+}
+
+/* With the checksum enabled, output is produced a slice at a time and
+ * each slice is CRCed straight away, while it is still in L1, instead
+ * of being read back from memory in a second pass */
+int decoderRun(HuffDecoder *dec, const uint8_t *in, size_t in_len, uint64_t valid_bits,
+               uint8_t *out, uint64_t count) {
+    if (dec->streaming) return decoderStaged(dec, in, in_len, valid_bits, out, count);
+    if (!dec->crc_slice) return decoderDecode(dec, in, in_len, valid_bits, out, count);
+
+    for (uint64_t done = 0; done < count; done += dec->crc_slice) {
+        uint64_t n = count - done < dec->crc_slice ? count - done : dec->crc_slice;
+        if (!decoderDecode(dec, in, in_len, valid_bits, out + done, n)) return 0;
+        dec->checksum = crc32Update(dec->checksum, out + done, n);
+    }
+    return 1;
+}
+
+/* Bytes the decoder has taken from the front of the buffer; the next
+ * decoderRun() expects the buffer to start after them */
+size_t decoderConsume(HuffDecoder *dec) {
+    size_t used = dec->state.pos;
+    dec->state.pos = 0;
+    return used;
+}
+
+/* Keep a running CRC of the output in dec->checksum. Slices are half of
+ * L1 so the decode table and the slice fit together. */
+void decoderEnableChecksum(HuffDecoder *dec) {
+    size_t slice = cpuL1DataCacheSize() / 2;
+    dec->crc_slice = slice < 4096 ? 4096 : slice;
+    dec->checksum = 0;
+}
+
+void decoderFree(HuffDecoder *dec) {
+    freeDecodeTable(&dec->table);
+}
+
+/* In-place decoding: the payload sits at the end of a buffer of
+ * original_size + margin bytes and output grows from the front. Output
+ * byte k is written only after the decoder has loaded every input byte
+ * before the one holding the next unread bit, so the margin must cover
+ * the most that output ever leads input: max over k of
+ * k - floor(bits_before_k / 8), less the compressed/original difference.
+ * encodeImpl() tracks that lead in the BitBuffer as it goes when asked
+ * to, and the header's margin_code records its power-of-two ceiling (0
+ * when it was not tracked). */
+uint8_t inPlaceMarginCode(const InPlaceMargin *m, uint64_t original_size, uint64_t compressed_size) {
+    int64_t need = m->worst + 1 + (int64_t)compressed_size - (int64_t)original_size;
+    uint8_t code = 1;
+    while (need > 1 && code < 64) {
+        need = (need + 1) / 2;
+        code++;
+    }
+    return code;
+}
+
+/* Bytes past original_size an in-place buffer needs; without a recorded
+ * margin, the whole payload (no overlap at all) */
+uint64_t inPlaceMargin(const HuffHeader *header) {
+    if (header->margin_code == 0 || header->margin_code > 64) return header->compressed_size;
+    return 1ull << (header->margin_code - 1);
+}
+
+/* Decode the payload held in the last compressed_size bytes of buf into
+ * its front. buf_size must be at least original_size + inPlaceMargin(). */
+int decompressInPlace(uint8_t *buf, size_t buf_size, Node *root, const HuffHeader *header) {
+    if (!root || buf_size < header->original_size || buf_size < header->compressed_size ||
+        buf_size - header->original_size < inPlaceMargin(header)) {
+        fprintf(stderr, "Error: In-place buffer of %zu bytes is too small\n", buf_size);
+        return 0;
+    }
+
+    HuffDecoder dec;
+    if (!decoderInit(&dec, root, header->original_size)) return 0;
+
+    const uint8_t *in = buf + buf_size - header->compressed_size;
+    uint64_t valid_bits = header->compressed_size * 8 - header->padding_bits;
+    int ok = decoderRun(&dec, in, header->compressed_size, valid_bits, buf, header->original_size);
+    decoderFree(&dec);
+    return ok;
+}
+
+/* Streaming decode of a payload that starts at fp's position:
+ *
+ *   streamDecoderInit(&s, &dec, fp, payload, padding_bits, chunk);
+ *   for each piece of at most chunk symbols:
+ *       streamDecoderFill(&s, n, NULL);
+ *       streamDecoderRun(&s, out, n, NULL);
+ *   streamDecoderFree(&s);
+ *
+ * The input buffer holds two chunks' worth of input bound and is read
+ * from a cursor; the unread tail is slid to the front only when a refill
+ * is due and the cursor is past half the buffer, so each byte is copied
+ * at most about once. */
+int streamDecoderInit(HuffStreamDecoder *s, HuffDecoder *dec, FILE *fp, uint64_t payload,
+                      uint8_t padding_bits, uint64_t chunk) {
+    memset(s, 0, sizeof(HuffStreamDecoder));
+    s->dec = dec;
+    s->fp = fp;
+    s->cap = 2 * decoderInputBound(dec, chunk) + 8;
+    s->unread = payload;
+    s->valid_bits = payload * 8 - padding_bits;
+    s->in = memAlloc(s->cap);
+    return s->in != NULL;
+}
+
+/* Read enough input that decoding count more symbols cannot run out of
+ * buffered input, or all that is left; *got is the bytes read. Returns
+ * 0 on a short read. */
+int streamDecoderFill(HuffStreamDecoder *s, uint64_t count, size_t *got) {
+    if (got) *got = 0;
+    size_t need = decoderInputBound(s->dec, count);
+    if (s->len - s->start >= need || s->unread == 0) return 1;
+
+    if (s->start > s->cap / 2 || s->cap - s->len < need - (s->len - s->start)) {
+        memmove(s->in, s->in + s->start, s->len - s->start);
+        s->len -= s->start;
+        s->start = 0;
+    }
+    size_t want = s->cap - s->len < s->unread ? s->cap - s->len : s->unread;
+    size_t read = readChunked(s->fp, s->in + s->len, want, NULL);
+    s->len += read;
+    s->unread -= read;
+    if (got) *got = read;
+    return read == want;
+}
+
+/* Decode count symbols from the buffered input and drop the input bytes
+ * they used (*used) */
+int streamDecoderRun(HuffStreamDecoder *s, uint8_t *out, uint64_t count, size_t *used) {
+    if (!decoderRun(s->dec, s->in + s->start, s->len - s->start, s->valid_bits, out, count)) return 0;
+
+    size_t n = decoderConsume(s->dec);
+    if (n > s->len - s->start) n = s->len - s->start;
+    s->start += n;
+    s->valid_bits = s->valid_bits > (uint64_t)n * 8 ? s->valid_bits - (uint64_t)n * 8 : 0;
+    if (used) *used = n;
+    return 1;
+}
+
+void streamDecoderFree(HuffStreamDecoder *s) {
+    memFree(s->in);
+    s->in = NULL;
+}
+
+/* File helpers shared by the tools */
+long getFileSize(const char *filename) {
+    struct stat st;
+    if (stat(filename, &st) == 0) {
+        return st.st_size;
+    }
+    return -1;
+}
+
+/* Read in HUFF_IO_CHUNK pieces so a progress meter can follow large
+ * files; progress may be NULL */
+size_t readChunked(FILE *fp, uint8_t *data, size_t size, uint64_t *progress) {
+    size_t done = 0;
+    while (done < size) {
+        size_t want = size - done < HUFF_IO_CHUNK ? size - done : HUFF_IO_CHUNK;
+        HUFF_PROBE2(io_read_submit, done, want);
+        uint64_t t0 = traceEnabled() ? traceNow() : 0;
+        size_t got = fread(data + done, 1, want, fp);
+        if (t0) traceSpan("read", "io", t0, traceNow(), got);
+        HUFF_PROBE2(io_read_complete, done, got);
+        done += got;
+        progressAdd(progress, got);
+        if (got != want) break;
+    }
+    return done;
+}
+
+size_t writeChunked(FILE *fp, const uint8_t *data, size_t size, uint64_t *progress) {
+    size_t done = 0;
+    while (done < size) {
+        size_t want = size - done < HUFF_IO_CHUNK ? size - done : HUFF_IO_CHUNK;
+        HUFF_PROBE2(io_write_submit, done, want);
+        uint64_t t0 = traceEnabled() ? traceNow() : 0;
+        size_t put = fwrite(data + done, 1, want, fp);
+        if (t0) traceSpan("write", "io", t0, traceNow(), put);
+        HUFF_PROBE2(io_write_complete, done, put);
+        done += put;
+        progressAdd(progress, put);
+        if (put != want) break;
+    }
+    return done;
+}
+
+/* Write binary header */
+int writeHeader(FILE *fp, const HuffHeader *header) {
+    return fwrite(header, sizeof(HuffHeader), 1, fp) == 1;
+}
+
+/* Write the frequency table in binary format; returns the entries
+ * written, 0 on error */
+uint16_t writeFreqTable(FILE *fp, const uint32_t freq[]) {
+    uint16_t tree_size = 0;
+    
+    for (int i = 0; i < MAXN; i++) {
+        if (freq[i] > 0) {
+            FreqEntry entry = { .ch = i, .freq = freq[i] };
+            if (fwrite(&entry, sizeof(FreqEntry), 1, fp) != 1) {
+                return 0;
+            }
+            tree_size++;
+        }
+    }
+    return tree_size;
+}
+
+/* Read frequency table from binary format */
+int readFreqTable(FILE *fp, uint32_t freq[], uint16_t tree_size) {
+    memset(freq, 0, MAXN * sizeof(uint32_t));
+    
+    for (uint16_t i = 0; i < tree_size; i++) {
+        FreqEntry entry;
+        if (fread(&entry, sizeof(FreqEntry), 1, fp) != 1) {
+            return 0;
+        }
+        freq[entry.ch] = entry.freq;
+    }
+    
+    return 1;
+}
+
+#endif /* HUFF_IMPLEMENTATION */
+
+#endif /* HUFF_H */
@@ -0,0 +1,144 @@
+/* legacy.h - Single Header huffman-00 Format Support
+ *
+ * huffman-00 .enc files carry no magic number: a native long with the
+ * original size, an unsigned[256] frequency table, then the same MSB-first
+ * bitstream as v1 with no padding count (decoding stops after size
+ * symbols). legacyPlausible() tells such a header from noise, and
+ * legacyBuildTree() rebuilds the tree exactly as huffman-00 did - its
+ * heap breaks ties differently from pqueue.h - so the stream can go
+ * through the table-driven decoder.
+ *
+ * Usage:
+ *   #define LEGACY_IMPLEMENTATION
+ *   #include "legacy.h"
+ */
+
+#ifndef LEGACY_H
+#define LEGACY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "pqueue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LEGACY_SYMBOLS 256
+
+/* On-disk header: long and unsigned as huffman-00 was built (LP64) */
+typedef struct {
+    int64_t size;
+    uint32_t freq[LEGACY_SYMBOLS];
+} __attribute__((packed)) LegacyHeader;
+
+/* Legacy Interface */
+int legacyReadHeader(FILE *fp, LegacyHeader *header);
+int legacyPlausible(const LegacyHeader *header, uint64_t file_size);
+Node *legacyBuildTree(const uint32_t freq[]);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* ============================================================================
+ * IMPLEMENTATION
+ * ============================================================================ */
+
+#ifdef LEGACY_IMPLEMENTATION
+
+int legacyReadHeader(FILE *fp, LegacyHeader *header) {
+    return fread(header, sizeof(LegacyHeader), 1, fp) == 1;
+}
+
+/* The frequencies must add up to the size (each one wraps at 2^32 past
+ * 4 GiB, so compare modulo 2^32), and a non-empty file needs a payload */
+int legacyPlausible(const LegacyHeader *header, uint64_t file_size) {
+    if (file_size < sizeof(LegacyHeader) || header->size < 0) return 0;
+
+    uint64_t sum = 0;
+    for (int i = 0; i < LEGACY_SYMBOLS; i++) sum += header->freq[i];
+    if (sum > (uint64_t)header->size || (uint32_t)sum != (uint32_t)header->size) return 0;
+
+    return header->size == 0 || file_size > sizeof(LegacyHeader);
+}
+
+/* huffman-00's binary min-heap, step for step */
+static void legacyHeapify(Node **heap, int size, int idx) {
+    for (;;) {
+        int smallest = idx;
+        int left = 2 * idx + 1;
+        int right = 2 * idx + 2;
+
+        if (left < size && heap[left]->freq < heap[smallest]->freq) smallest = left;
+        if (right < size && heap[right]->freq < heap[smallest]->freq) smallest = right;
+        if (smallest == idx) return;
+
+        Node *t = heap[smallest];
+        heap[smallest] = heap[idx];
+        heap[idx] = t;
+        idx = smallest;
+    }
+}
+
+static Node *legacyExtractMin(Node **heap, int *size) {
+    Node *min = heap[0];
+    heap[0] = heap[*size - 1];
+    --*size;
+    legacyHeapify(heap, *size, 0);
+    return min;
+}
+
+static void legacyInsert(Node **heap, int *size, Node *node) {
+    int i = (*size)++;
+    while (i && node->freq < heap[(i - 1) / 2]->freq) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = node;
+}
+
+/* Same shape as huffman-00: an empty table gives a lone '$' leaf, one
+ * symbol hangs off the left of a '$' root (code "0"). Internal sums
+ * wrap at 2^32 as they did there. */
+Node *legacyBuildTree(const uint32_t freq[]) {
+    Node *heap[LEGACY_SYMBOLS];
+    int size = 0;
+    for (int i = 0; i < LEGACY_SYMBOLS; i++) {
+        if (freq[i] > 0) {
+            heap[size] = newNode((uint8_t)i, freq[i], NULL, NULL);
+            if (!heap[size]) goto fail;
+            size++;
+        }
+    }
+
+    if (size == 0) return newNode('$', 0, NULL, NULL);
+    if (size == 1) {
+        Node *root = newNode('$', heap[0]->freq, heap[0], NULL);
+        if (!root) goto fail;
+        return root;
+    }
+
+    for (int i = (size - 2) / 2; i >= 0; --i) legacyHeapify(heap, size, i);
+
+    while (size != 1) {
+        Node *left = legacyExtractMin(heap, &size);
+        Node *right = legacyExtractMin(heap, &size);
+        Node *top = newNode('$', left->freq + right->freq, left, right);
+        if (!top) {
+            freeTree(left);
+            freeTree(right);
+            goto fail;
+        }
+        legacyInsert(heap, &size, top);
+    }
+    return heap[0];
+
+fail:
+    for (int i = 0; i < size; i++) freeTree(heap[i]);
+    return NULL;
+}
+
+#endif /* LEGACY_IMPLEMENTATION */
+
+#endif /* LEGACY_H */
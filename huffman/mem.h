@@ -0,0 +1,289 @@
+/* mem.h - Single Header Memory Accounting
+ *
+ * memAlloc()/memCalloc()/memRealloc()/memFree() wrap the C allocator and
+ * keep a running total and high-water mark of live bytes. Each block
+ * carries a 16-byte size prefix so memFree() needs no size argument.
+ * With memSetLimit() set, a request that would take the live total over
+ * the budget fails with NULL instead of growing the process until the
+ * OOM killer steps in.
+ *
+ * memSetHugePages() backs blocks of MEM_HUGE_PAGE or more with huge
+ * pages to cut TLB misses on multi-GB buffers: MEM_HUGE_THP maps them
+ * aligned and madvise(MADV_HUGEPAGE)s them, MEM_HUGE_EXPLICIT first tries
+ * MAP_HUGETLB from the reserved pool. Either falls back to the next
+ * option (finally plain malloc) when the kernel says no.
+ *
+ * Usage:
+ *   #define MEM_IMPLEMENTATION
+ *   #include "mem.h"
+ */
+
+#ifndef MEM_H
+#define MEM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MEM_HUGE_PAGE (2u << 20)
+
+typedef enum {
+    MEM_HUGE_OFF,
+    MEM_HUGE_THP,
+    MEM_HUGE_EXPLICIT
+} MemHugeMode;
+
+/* Memory Interface */
+void *memAlloc(size_t size);
+void *memCalloc(size_t count, size_t size);
+void *memRealloc(void *ptr, size_t size);
+void memFree(void *ptr);
+void memSetLimit(uint64_t bytes);
+uint64_t memLimit(void);
+uint64_t memCurrent(void);
+uint64_t memPeak(void);
+int memFits(uint64_t bytes);
+int memParseSize(const char *text, uint64_t *bytes);
+void memSetHugePages(MemHugeMode mode);
+int memParseHugePages(const char *text, MemHugeMode *mode);
+uint64_t memHugeBytes(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* ============================================================================
+ * IMPLEMENTATION
+ * ============================================================================ */
+
+#ifdef MEM_IMPLEMENTATION
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+/* Prefix: block size, then the mapping length (0 for malloc blocks) */
+#define MEM_PREFIX 16
+
+static uint64_t mem_current = 0;
+static uint64_t mem_peak = 0;
+static uint64_t mem_limit = 0;  /* 0 = unlimited */
+static MemHugeMode mem_huge = MEM_HUGE_OFF;
+static uint64_t mem_huge_bytes = 0;
+
+/* Reserve bytes against the budget; 0 if the limit would be exceeded */
+static int memCharge(uint64_t bytes) {
+    uint64_t now = __atomic_add_fetch(&mem_current, bytes, __ATOMIC_RELAXED);
+    if (mem_limit && now > mem_limit) {
+        __atomic_sub_fetch(&mem_current, bytes, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    uint64_t peak = __atomic_load_n(&mem_peak, __ATOMIC_RELAXED);
+    while (now > peak &&
+           !__atomic_compare_exchange_n(&mem_peak, &peak, now, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+    return 1;
+}
+
+static void memRelease(uint64_t bytes) {
+    __atomic_sub_fetch(&mem_current, bytes, __ATOMIC_RELAXED);
+}
+
+/* Huge-page backed anonymous mapping of at least bytes, or NULL to fall
+ * back to malloc. The memory is zeroed. */
+static void *memMapHuge(size_t bytes, size_t *map_len) {
+    if (mem_huge == MEM_HUGE_OFF || bytes < MEM_HUGE_PAGE) return NULL;
+    if (bytes > SIZE_MAX - 2 * MEM_HUGE_PAGE) return NULL;
+    size_t len = (bytes + MEM_HUGE_PAGE - 1) & ~(size_t)(MEM_HUGE_PAGE - 1);
+
+#ifdef MAP_HUGETLB
+    if (mem_huge == MEM_HUGE_EXPLICIT) {
+        void *p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            *map_len = len;
+            return p;
+        }
+    }
+#endif
+
+    /* Over-map by one huge page and trim so the block starts aligned */
+    uint8_t *raw = mmap(NULL, len + MEM_HUGE_PAGE, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return NULL;
+
+    uintptr_t addr = (uintptr_t)raw;
+    uint8_t *p = (uint8_t *)((addr + MEM_HUGE_PAGE - 1) & ~(uintptr_t)(MEM_HUGE_PAGE - 1));
+    size_t head = p - raw;
+    if (head) munmap(raw, head);
+    if (MEM_HUGE_PAGE - head) munmap(p + len, MEM_HUGE_PAGE - head);
+
+#ifdef MADV_HUGEPAGE
+    madvise(p, len, MADV_HUGEPAGE);
+#endif
+    *map_len = len;
+    return p;
+}
+
+static void *memAllocBlock(size_t size, int zero) {
+    if (size > SIZE_MAX - MEM_PREFIX) return NULL;
+    if (!memCharge(size)) return NULL;
+
+    size_t map_len = 0;
+    uint8_t *base = memMapHuge(size + MEM_PREFIX, &map_len);
+    if (base) {
+        __atomic_add_fetch(&mem_huge_bytes, map_len, __ATOMIC_RELAXED);
+    } else {
+        base = zero ? calloc(1, size + MEM_PREFIX) : malloc(size + MEM_PREFIX);
+    }
+    if (!base) {
+        memRelease(size);
+        return NULL;
+    }
+    memcpy(base, &size, sizeof(size));
+    memcpy(base + sizeof(size), &map_len, sizeof(map_len));
+    return base + MEM_PREFIX;
+}
+
+void *memAlloc(size_t size) {
+    return memAllocBlock(size, 0);
+}
+
+void *memCalloc(size_t count, size_t size) {
+    if (size && count > SIZE_MAX / size) return NULL;
+    return memAllocBlock(count * size, 1);
+}
+
+/* Like realloc(): on failure the old block is left untouched */
+void *memRealloc(void *ptr, size_t size) {
+    if (!ptr) return memAlloc(size);
+    if (size > SIZE_MAX - MEM_PREFIX) return NULL;
+
+    uint8_t *base = (uint8_t *)ptr - MEM_PREFIX;
+    size_t old, map_len;
+    memcpy(&old, base, sizeof(old));
+    memcpy(&map_len, base + sizeof(old), sizeof(map_len));
+
+    /* Mapped blocks, and malloc blocks crossing into huge-page size, move */
+    if (map_len || (mem_huge != MEM_HUGE_OFF && size + MEM_PREFIX >= MEM_HUGE_PAGE)) {
+        if (map_len && size + MEM_PREFIX <= map_len) {
+            if (size > old && !memCharge(size - old)) return NULL;
+            if (size < old) memRelease(old - size);
+            memcpy(base, &size, sizeof(size));
+            return ptr;
+        }
+        void *moved = memAlloc(size);
+        if (!moved) return NULL;
+        memcpy(moved, ptr, old < size ? old : size);
+        memFree(ptr);
+        return moved;
+    }
+
+    if (size > old && !memCharge(size - old)) return NULL;
+
+    uint8_t *grown = realloc(base, size + MEM_PREFIX);
+    if (!grown) {
+        if (size > old) memRelease(size - old);
+        return NULL;
+    }
+    if (size < old) memRelease(old - size);
+
+    memcpy(grown, &size, sizeof(size));
+    return grown + MEM_PREFIX;
+}
+
+void memFree(void *ptr) {
+    if (!ptr) return;
+
+    uint8_t *base = (uint8_t *)ptr - MEM_PREFIX;
+    size_t size, map_len;
+    memcpy(&size, base, sizeof(size));
+    memcpy(&map_len, base + sizeof(size), sizeof(map_len));
+    memRelease(size);
+    if (map_len) {
+        __atomic_sub_fetch(&mem_huge_bytes, map_len, __ATOMIC_RELAXED);
+        munmap(base, map_len);
+    } else {
+        free(base);
+    }
+}
+
+void memSetLimit(uint64_t bytes) {
+    mem_limit = bytes;
+}
+
+uint64_t memLimit(void) {
+    return mem_limit;
+}
+
+uint64_t memCurrent(void) {
+    return __atomic_load_n(&mem_current, __ATOMIC_RELAXED);
+}
+
+uint64_t memPeak(void) {
+    return __atomic_load_n(&mem_peak, __ATOMIC_RELAXED);
+}
+
+/* Would a further allocation of this size stay within the limit? */
+int memFits(uint64_t bytes) {
+    return !mem_limit || memCurrent() + bytes <= mem_limit;
+}
+
+/* Parse a byte count with an optional binary suffix: K, KiB or KB (and
+ * M/G/T likewise), all powers of 1024, so "512M", "2GiB", "65536". Values
+ * that overflow 64 bits are rejected rather than wrapped. */
+int memParseSize(const char *text, uint64_t *bytes) {
+    if (*text < '0' || *text > '9') return 0;
+
+    char *end;
+    errno = 0;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (errno == ERANGE) return 0;
+
+    int shift = 0;
+    switch (*end) {
+    case 'k': case 'K': shift = 10; break;
+    case 'm': case 'M': shift = 20; break;
+    case 'g': case 'G': shift = 30; break;
+    case 't': case 'T': shift = 40; break;
+    }
+    if (shift) {
+        end++;
+        if (strcmp(end, "iB") == 0) end += 2;
+        else if (strcmp(end, "B") == 0) end++;
+        if (value > (UINT64_MAX >> shift)) return 0;
+    }
+    if (*end != '\0') return 0;
+
+    *bytes = (uint64_t)value << shift;
+    return 1;
+}
+
+void memSetHugePages(MemHugeMode mode) {
+    mem_huge = mode;
+}
+
+/* "off", "thp" or "explicit" */
+int memParseHugePages(const char *text, MemHugeMode *mode) {
+    if (strcmp(text, "off") == 0) *mode = MEM_HUGE_OFF;
+    else if (strcmp(text, "thp") == 0) *mode = MEM_HUGE_THP;
+    else if (strcmp(text, "explicit") == 0) *mode = MEM_HUGE_EXPLICIT;
+    else return 0;
+    return 1;
+}
+
+/* Bytes currently mapped for huge-page backed blocks */
+uint64_t memHugeBytes(void) {
+    return __atomic_load_n(&mem_huge_bytes, __ATOMIC_RELAXED);
+}
+
+#endif /* MEM_IMPLEMENTATION */
+
+#endif /* MEM_H */
@@ -0,0 +1,156 @@
+/* perfcount.h - Single Header Hardware Performance Counters
+ *
+ * Opens cycles, instructions, branch-misses, L1D read misses and LLC misses
+ * for the calling thread through the raw perf_event_open syscall. Counters
+ * the kernel or CPU refuses (VMs, perf_event_paranoid) are simply skipped;
+ * on non-Linux builds nothing is opened.
+ *
+ * Usage:
+ *   #define PERFCOUNT_IMPLEMENTATION
+ *   #include "perfcount.h"
+ */
+
+#ifndef PERFCOUNT_H
+#define PERFCOUNT_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_MAX_COUNTERS
+};
+
+typedef struct {
+    int fd[PERF_MAX_COUNTERS];
+    int opened;
+} PerfCounters;
+
+/* Perf Counter Interface */
+int perfOpen(PerfCounters *pc);
+void perfRead(const PerfCounters *pc, uint64_t values[PERF_MAX_COUNTERS]);
+int perfAvailable(const PerfCounters *pc, int counter);
+const char *perfCounterName(int counter);
+void perfClose(PerfCounters *pc);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* ============================================================================
+ * IMPLEMENTATION
+ * ============================================================================ */
+
+#ifdef PERFCOUNT_IMPLEMENTATION
+
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+static const char *perf_names[PERF_MAX_COUNTERS] = {
+    "cycles", "instructions", "branch_misses", "l1d_misses", "llc_misses"
+};
+
+const char *perfCounterName(int counter) {
+    return counter >= 0 && counter < PERF_MAX_COUNTERS ? perf_names[counter] : "unknown";
+}
+
+int perfAvailable(const PerfCounters *pc, int counter) {
+    return pc && pc->fd[counter] >= 0;
+}
+
+#ifdef __linux__
+
+static int perfOpenOne(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+int perfOpen(PerfCounters *pc) {
+    static const struct {
+        uint32_t type;
+        uint64_t config;
+    } events[PERF_MAX_COUNTERS] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                              (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    };
+
+    pc->opened = 0;
+    for (int i = 0; i < PERF_MAX_COUNTERS; i++) {
+        pc->fd[i] = perfOpenOne(events[i].type, events[i].config);
+        if (pc->fd[i] >= 0) pc->opened++;
+    }
+    return pc->opened;
+}
+
+/* Counters are free-running; callers take deltas between two reads.
+ * Values are scaled up when the kernel had to multiplex counters. */
+void perfRead(const PerfCounters *pc, uint64_t values[PERF_MAX_COUNTERS]) {
+    for (int i = 0; i < PERF_MAX_COUNTERS; i++) {
+        uint64_t buf[3];
+        values[i] = 0;
+        if (!pc || pc->fd[i] < 0) continue;
+        if (read(pc->fd[i], buf, sizeof(buf)) != sizeof(buf)) continue;
+
+        if (buf[2] > 0 && buf[2] < buf[1]) {
+            values[i] = (uint64_t)((double)buf[0] * buf[1] / buf[2]);
+        } else {
+            values[i] = buf[0];
+        }
+    }
+}
+
+void perfClose(PerfCounters *pc) {
+    for (int i = 0; i < PERF_MAX_COUNTERS; i++) {
+        if (pc->fd[i] >= 0) close(pc->fd[i]);
+        pc->fd[i] = -1;
+    }
+    pc->opened = 0;
+}
+
+#else /* !__linux__ */
+
+int perfOpen(PerfCounters *pc) {
+    for (int i = 0; i < PERF_MAX_COUNTERS; i++) pc->fd[i] = -1;
+    pc->opened = 0;
+    return 0;
+}
+
+void perfRead(const PerfCounters *pc, uint64_t values[PERF_MAX_COUNTERS]) {
+    (void)pc;
+    memset(values, 0, PERF_MAX_COUNTERS * sizeof(uint64_t));
+}
+
+void perfClose(PerfCounters *pc) {
+    pc->opened = 0;
+}
+
+#endif /* __linux__ */
+
+#endif /* PERFCOUNT_IMPLEMENTATION */
+
+#endif /* PERFCOUNT_H */
@@ -1,5 +1,17 @@
 /* pqueue.h - Single Header Priority Queue Library for Huffman Compression
- * 
+ *
+ * PQ is the binary heap of Node pointers that buildHuffmanTree() uses.
+ * Its tie-breaking decides the shape of every HUFF v1 tree, so it stays
+ * as it is.
+ *
+ * PQ_DEFINE(Name, Type, LESS) generates a growable 4-ary min-heap for any
+ * element type, with LESS expanded inline at every comparison and the
+ * four children of a slot kept in one aligned group, so each sift level
+ * touches one cache line. PQ4 is its instantiation for 64-bit items
+ * packing a 32-bit key above a 32-bit id (PQ4_ITEM), where equal keys
+ * order by id. C++ gets the same sift loops as the PQueue<T, Less>
+ * template.
+ *
  * Usage: 
  *   #define PQUEUE_IMPLEMENTATION
  *   #include "pqueue.h"
@@ -45,6 +57,230 @@ void freeTree(Node *root);
 }
 #endif
 
+/* Allocator hooks, e.g. for memory accounting */
+#ifndef PQ_MALLOC
+#define PQ_MALLOC(size) malloc(size)
+#define PQ_FREE(ptr) free(ptr)
+#endif
+
+/* ============================================================================
+ * GENERIC HEAP
+ * ============================================================================
+ *
+ * PQ_DEFINE(Name, Type, LESS) declares a growable 4-ary min-heap type
+ * Name holding Type values, and static inline functions NameInit,
+ * NameReserve, NamePush, NamePop, NameReplaceTop, NameBuild, NameTop,
+ * NameSize, NameEmpty and NameFree. LESS(a, b) is expanded with two Type
+ * lvalues and must be nonzero when a comes out before b; a macro or an
+ * inline function both end up compiled into the sift loops. Push,
+ * Reserve and Build return 0 only when memory runs out, Pop and
+ * ReplaceTop when the heap is empty.
+ *
+ *   #define U64_LESS(a, b) ((a) < (b))
+ *   PQ_DEFINE(U64Heap, uint64_t, U64_LESS)
+ *
+ *   U64Heap h;
+ *   U64HeapInit(&h);
+ *   U64HeapPush(&h, 42);
+ */
+
+#define PQ_ARITY 4          /* PQ_SIFT_DOWN's pairwise minimum assumes 4 */
+#define PQ_ALIGN 64
+#define PQ_COPY(x) (x)
+
+/* The sift loops of every heap below. k is the hole, an lvalue that ends
+ * up where item lands; MOVE is PQ_COPY in C and std::move in C++. */
+#define PQ_SIFT_UP(heap, k, item, LESS, MOVE)                                  \
+    while ((k) > 0) {                                                          \
+        size_t pq_parent_ = ((k) - 1) / PQ_ARITY;                              \
+        if (!LESS(item, (heap)[pq_parent_])) break;                            \
+        (heap)[k] = MOVE((heap)[pq_parent_]);                                  \
+        (k) = pq_parent_;                                                      \
+    }                                                                          \
+    (heap)[k] = MOVE(item)
+
+/* A full group of children is reduced pairwise, without a data-dependent
+ * loop; either way the first of equal children wins */
+#define PQ_SIFT_DOWN(heap, n, k, item, LESS, MOVE)                             \
+    for (;;) {                                                                 \
+        size_t pq_c_ = PQ_ARITY * (k) + 1;                                     \
+        if (pq_c_ >= (n)) break;                                               \
+        size_t pq_m_ = pq_c_;                                                  \
+        if (pq_c_ + PQ_ARITY <= (n)) {                                         \
+            size_t pq_a_ = pq_c_ +                                             \
+                (LESS((heap)[pq_c_ + 1], (heap)[pq_c_]) ? 1 : 0);              \
+            size_t pq_b_ = pq_c_ + 2 +                                         \
+                (LESS((heap)[pq_c_ + 3], (heap)[pq_c_ + 2]) ? 1 : 0);          \
+            pq_m_ = LESS((heap)[pq_b_], (heap)[pq_a_]) ? pq_b_ : pq_a_;        \
+        } else {                                                               \
+            for (size_t pq_j_ = pq_c_ + 1; pq_j_ < (n); pq_j_++) {             \
+                if (LESS((heap)[pq_j_], (heap)[pq_m_])) pq_m_ = pq_j_;         \
+            }                                                                  \
+        }                                                                      \
+        if (!LESS((heap)[pq_m_], item)) break;                                 \
+        (heap)[k] = MOVE((heap)[pq_m_]);                                       \
+        (k) = pq_m_;                                                           \
+    }                                                                          \
+    (heap)[k] = MOVE(item)
+
+/* Slots start PQ_ARITY - 1 past a PQ_ALIGN boundary, so the children of
+ * slot k, 4k+1..4k+4, begin at a multiple of four slots from it: for
+ * elements of 4, 8 or 16 bytes every group sits in one cache line */
+#define PQ_DEFINE(Name, Type, LESS)                                            \
+typedef struct {                                                               \
+    Type *heap;                                                                \
+    void *raw;                                                                 \
+    size_t n;                                                                  \
+    size_t cap;                                                                \
+} Name;                                                                        \
+                                                                               \
+static inline void Name##Init(Name *pq) {                                      \
+    pq->heap = NULL;                                                           \
+    pq->raw = NULL;                                                            \
+    pq->n = 0;                                                                 \
+    pq->cap = 0;                                                               \
+}                                                                              \
+                                                                               \
+static inline int Name##Reserve(Name *pq, size_t cap) {                        \
+    if (cap <= pq->cap) return 1;                                              \
+    if (cap > (SIZE_MAX - PQ_ALIGN) / sizeof(Type) - PQ_ARITY) return 0;       \
+    void *raw = PQ_MALLOC((cap + PQ_ARITY - 1) * sizeof(Type) + PQ_ALIGN);     \
+    if (!raw) return 0;                                                        \
+    uintptr_t base = ((uintptr_t)raw + PQ_ALIGN - 1) &                         \
+                     ~(uintptr_t)(PQ_ALIGN - 1);                               \
+    Type *heap = (Type *)base + PQ_ARITY - 1;                                  \
+    for (size_t i = 0; i < pq->n; i++) heap[i] = pq->heap[i];                  \
+    PQ_FREE(pq->raw);                                                          \
+    pq->heap = heap;                                                           \
+    pq->raw = raw;                                                             \
+    pq->cap = cap;                                                             \
+    return 1;                                                                  \
+}                                                                              \
+                                                                               \
+static inline void Name##SiftDown(Type *heap, size_t n, size_t k, Type item) { \
+    PQ_SIFT_DOWN(heap, n, k, item, LESS, PQ_COPY);                             \
+}                                                                              \
+                                                                               \
+static inline int Name##Push(Name *pq, Type item) {                            \
+    if (pq->n == pq->cap &&                                                    \
+        !Name##Reserve(pq, pq->cap < 8 ? 16 : pq->cap * 2)) return 0;          \
+    Type *heap = pq->heap;                                                     \
+    size_t k = pq->n++;                                                        \
+    PQ_SIFT_UP(heap, k, item, LESS, PQ_COPY);                                  \
+    return 1;                                                                  \
+}                                                                              \
+                                                                               \
+static inline int Name##Pop(Name *pq, Type *item) {                            \
+    if (pq->n == 0) return 0;                                                  \
+    *item = pq->heap[0];                                                       \
+    size_t n = --pq->n;                                                        \
+    if (n > 0) Name##SiftDown(pq->heap, n, 0, pq->heap[n]);                    \
+    return 1;                                                                  \
+}                                                                              \
+                                                                               \
+/* Pop the minimum into *top and push item with one sift */                    \
+static inline int Name##ReplaceTop(Name *pq, Type item, Type *top) {           \
+    if (pq->n == 0) return 0;                                                  \
+    *top = pq->heap[0];                                                        \
+    Name##SiftDown(pq->heap, pq->n, 0, item);                                  \
+    return 1;                                                                  \
+}                                                                              \
+                                                                               \
+/* Replace the contents with items[0..n), heapified in O(n) */                 \
+static inline int Name##Build(Name *pq, const Type *items, size_t n) {         \
+    pq->n = 0;                                                                 \
+    if (!Name##Reserve(pq, n)) return 0;                                       \
+    for (size_t i = 0; i < n; i++) pq->heap[i] = items[i];                     \
+    pq->n = n;                                                                 \
+    for (size_t k = n > 1 ? (n - 2) / PQ_ARITY + 1 : 0; k-- > 0; ) {           \
+        Name##SiftDown(pq->heap, n, k, pq->heap[k]);                           \
+    }                                                                          \
+    return 1;                                                                  \
+}                                                                              \
+                                                                               \
+static inline const Type *Name##Top(const Name *pq) {                          \
+    return pq->n ? &pq->heap[0] : NULL;                                        \
+}                                                                              \
+                                                                               \
+static inline size_t Name##Size(const Name *pq) {                              \
+    return pq->n;                                                              \
+}                                                                              \
+                                                                               \
+static inline int Name##Empty(const Name *pq) {                                \
+    return pq->n == 0;                                                         \
+}                                                                              \
+                                                                               \
+static inline void Name##Free(Name *pq) {                                      \
+    PQ_FREE(pq->raw);                                                          \
+    Name##Init(pq);                                                            \
+}
+
+/* 4-ary heap of packed (key, id) items: comparing the packed values orders
+ * by key, then id, straight from the array */
+#define PQ4_ITEM(key, id) (((uint64_t)(uint32_t)(key) << 32) | (uint32_t)(id))
+#define PQ4_KEY(item) ((uint32_t)((item) >> 32))
+#define PQ4_ID(item) ((uint32_t)(item))
+#define PQ4_LESS(a, b) ((a) < (b))
+PQ_DEFINE(PQ4, uint64_t, PQ4_LESS)
+
+#ifdef __cplusplus
+
+#include <vector>
+#include <functional>
+#include <utility>
+
+/* The same heap as a template: Less is a function object, so comparisons
+ * inline the same way. Storage is a plain std::vector, without the group
+ * alignment; needs C++11. */
+template <typename T, typename Less = std::less<T>>
+class PQueue {
+public:
+    explicit PQueue(Less less = Less()) : less_(less) {}
+
+    void reserve(size_t cap) { heap_.reserve(cap); }
+    size_t size() const { return heap_.size(); }
+    bool empty() const { return heap_.empty(); }
+    const T &top() const { return heap_.front(); }
+
+    void push(T item) {
+        size_t k = heap_.size();
+        heap_.push_back(item);
+        T *heap = heap_.data();
+        PQ_SIFT_UP(heap, k, item, less_, std::move);
+    }
+
+    /* Undefined on an empty queue, like std::priority_queue */
+    T pop() {
+        T min = std::move(heap_.front());
+        T last = std::move(heap_.back());
+        heap_.pop_back();
+        if (!heap_.empty()) siftDown(0, std::move(last));
+        return min;
+    }
+
+    /* Replace the contents with [first, last), heapified in O(n) */
+    template <typename It>
+    void build(It first, It last) {
+        heap_.assign(first, last);
+        size_t n = heap_.size();
+        for (size_t k = n > 1 ? (n - 2) / PQ_ARITY + 1 : 0; k-- > 0; ) {
+            siftDown(k, std::move(heap_[k]));
+        }
+    }
+
+private:
+    void siftDown(size_t k, T item) {
+        T *heap = heap_.data();
+        size_t n = heap_.size();
+        PQ_SIFT_DOWN(heap, n, k, item, less_, std::move);
+    }
+
+    std::vector<T> heap_;
+    Less less_;
+};
+
+#endif /* __cplusplus */
+
 /* ============================================================================
  * IMPLEMENTATION
  * ============================================================================ */
@@ -52,12 +288,12 @@ void freeTree(Node *root);
 #ifdef PQUEUE_IMPLEMENTATION
 
 PQ *PQinit(int maxN) {
-    PQ *pq = malloc(sizeof(PQ));
+    PQ *pq = PQ_MALLOC(sizeof(PQ));
     if (!pq) return NULL;
     
-    pq->heap = malloc((maxN + 1) * sizeof(Node*));
+    pq->heap = PQ_MALLOC((maxN + 1) * sizeof(Node*));
     if (!pq->heap) {
-        free(pq);
+        PQ_FREE(pq);
         return NULL;
     }
     
@@ -108,13 +344,13 @@ int PQempty(PQ *pq) {
 
 void PQfree(PQ *pq) {
     if (pq) {
-        free(pq->heap);
-        free(pq);
+        PQ_FREE(pq->heap);
+        PQ_FREE(pq);
     }
 }
 
 Node *newNode(uint8_t ch, uint32_t freq, Node *l, Node *r) {
-    Node *node = malloc(sizeof(Node));
+    Node *node = PQ_MALLOC(sizeof(Node));
     if (!node) return NULL;
     
     node->ch = ch;
@@ -128,7 +364,7 @@ void freeTree(Node *root) {
     if (root) {
         freeTree(root->left);
         freeTree(root->right);
-        free(root);
+        PQ_FREE(root);
     }
 }
 
@@ -0,0 +1,92 @@
+/* probes.h - USDT Static Tracepoints
+ *
+ * HUFF_PROBEn(name, args...) marks a point bpftrace, perf and SystemTap
+ * can attach to (provider "huff"), e.g.
+ *
+ *   bpftrace -e 'usdt:./dec:huff:decode_block_done { @[arg1] = count(); }'
+ *
+ * Each probe is a single NOP plus an ELF .note.stapsdt entry describing
+ * where its arguments live, so an unattached probe costs nothing but the
+ * argument setup. <sys/sdt.h> is used when installed; otherwise x86-64 ELF
+ * builds emit the same note format directly. Elsewhere, or with
+ * -DHUFF_NO_PROBES, every probe compiles away. Arguments are passed as
+ * 64-bit integers; strings as pointers (use str(argN) in bpftrace).
+ */
+
+#ifndef PROBES_H
+#define PROBES_H
+
+#include <stdint.h>
+
+#if defined(HUFF_NO_PROBES)
+
+#define HUFF_PROBE1(name, a1) ((void)0)
+#define HUFF_PROBE2(name, a1, a2) ((void)0)
+#define HUFF_PROBE3(name, a1, a2, a3) ((void)0)
+#define HUFF_PROBE4(name, a1, a2, a3, a4) ((void)0)
+
+#elif defined(__has_include) && __has_include(<sys/sdt.h>)
+
+#include <sys/sdt.h>
+#define HUFF_PROBE1(name, a1) DTRACE_PROBE1(huff, name, a1)
+#define HUFF_PROBE2(name, a1, a2) DTRACE_PROBE2(huff, name, a1, a2)
+#define HUFF_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(huff, name, a1, a2, a3)
+#define HUFF_PROBE4(name, a1, a2, a3, a4) DTRACE_PROBE4(huff, name, a1, a2, a3, a4)
+
+#elif defined(__x86_64__) && defined(__ELF__) && defined(__GNUC__)
+
+/* Version 3 stapsdt note: probe PC, .stapsdt.base (for prelink), no
+ * semaphore, then provider, name and an argument format such as
+ * "-8@%rax -8@8(%rsp)". Operands use the "nor" constraint so the
+ * compiler leaves each one wherever it already is. */
+#define HUFF_PROBE_ASM(name, args)                                          \
+    "990: nop\n"                                                            \
+    ".pushsection .note.stapsdt,\"\",\"note\"\n"                            \
+    ".balign 4\n"                                                           \
+    ".4byte 992f-991f, 994f-993f, 3\n"                                      \
+    "991: .asciz \"stapsdt\"\n"                                             \
+    "992: .balign 4\n"                                                      \
+    "993: .8byte 990b\n"                                                    \
+    ".8byte _.stapsdt.base\n"                                               \
+    ".8byte 0\n"                                                            \
+    ".asciz \"huff\"\n"                                                     \
+    ".asciz \"" #name "\"\n"                                                \
+    ".asciz \"" args "\"\n"                                                 \
+    "994: .balign 4\n"                                                      \
+    ".popsection\n"                                                         \
+    ".ifndef _.stapsdt.base\n"                                              \
+    ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+    ".weak _.stapsdt.base\n"                                                \
+    ".hidden _.stapsdt.base\n"                                              \
+    "_.stapsdt.base: .space 1\n"                                            \
+    ".size _.stapsdt.base, 1\n"                                             \
+    ".popsection\n"                                                         \
+    ".endif\n"
+
+#define HUFF_PROBE_ARG(a) "nor"((int64_t)(a))
+
+#define HUFF_PROBE1(name, a1)                                               \
+    __asm__ __volatile__(HUFF_PROBE_ASM(name, "-8@%0")                      \
+                         :: HUFF_PROBE_ARG(a1))
+#define HUFF_PROBE2(name, a1, a2)                                           \
+    __asm__ __volatile__(HUFF_PROBE_ASM(name, "-8@%0 -8@%1")                \
+                         :: HUFF_PROBE_ARG(a1), HUFF_PROBE_ARG(a2))
+#define HUFF_PROBE3(name, a1, a2, a3)                                       \
+    __asm__ __volatile__(HUFF_PROBE_ASM(name, "-8@%0 -8@%1 -8@%2")          \
+                         :: HUFF_PROBE_ARG(a1), HUFF_PROBE_ARG(a2),         \
+                            HUFF_PROBE_ARG(a3))
+#define HUFF_PROBE4(name, a1, a2, a3, a4)                                   \
+    __asm__ __volatile__(HUFF_PROBE_ASM(name, "-8@%0 -8@%1 -8@%2 -8@%3")    \
+                         :: HUFF_PROBE_ARG(a1), HUFF_PROBE_ARG(a2),         \
+                            HUFF_PROBE_ARG(a3), HUFF_PROBE_ARG(a4))
+
+#else
+
+#define HUFF_PROBE1(name, a1) ((void)0)
+#define HUFF_PROBE2(name, a1, a2) ((void)0)
+#define HUFF_PROBE3(name, a1, a2, a3) ((void)0)
+#define HUFF_PROBE4(name, a1, a2, a3, a4) ((void)0)
+
+#endif
+
+#endif /* PROBES_H */
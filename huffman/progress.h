@@ -0,0 +1,193 @@
+/* progress.h - Single Header Live Progress Meter
+ *
+ * Hot loops publish completed bytes with progressAdd(), a relaxed atomic
+ * add once per block. A separate idle-priority thread renders percent,
+ * MB/s and ETA to stderr every 250 ms, so the loops never format or
+ * write anything themselves. Between progressEnd() and the next
+ * progressBegin() the thread stays quiet and the caller owns stderr.
+ *
+ * Usage:
+ *   #define PROGRESS_IMPLEMENTATION
+ *   #include "progress.h"
+ */
+
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PROGRESS_INTERVAL_MS 250
+
+typedef struct {
+    int enabled;
+    int running;
+    int active;
+    int stop;
+    const char *label;
+    uint64_t total;
+    uint64_t done;      /* relaxed atomic, see progressAdd() */
+    uint64_t start_ns;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+} Progress;
+
+/* Progress Interface */
+int progressInit(Progress *p, int enabled);
+void progressBegin(Progress *p, const char *label, uint64_t total);
+void progressEnd(Progress *p);
+void progressFree(Progress *p);
+
+static inline __attribute__((always_inline)) void progressAdd(uint64_t *counter, uint64_t n) {
+    if (counter) __atomic_fetch_add(counter, n, __ATOMIC_RELAXED);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/* ============================================================================
+ * IMPLEMENTATION
+ * ============================================================================ */
+
+#ifdef PROGRESS_IMPLEMENTATION
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+
+static uint64_t progressNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void progressFormatBytes(char *out, size_t size, uint64_t bytes) {
+    static const char *units[] = { "B", "KiB", "MiB", "GiB", "TiB" };
+    double value = bytes;
+    int unit = 0;
+    while (value >= 1024 && unit < 4) {
+        value /= 1024;
+        unit++;
+    }
+    snprintf(out, size, unit ? "%.1f %s" : "%.0f %s", value, units[unit]);
+}
+
+/* Caller holds p->lock */
+static void progressRender(Progress *p, int final) {
+    uint64_t done = __atomic_load_n(&p->done, __ATOMIC_RELAXED);
+    if (done > p->total) done = p->total;
+
+    double elapsed = (progressNow() - p->start_ns) / 1e9;
+    double rate = elapsed > 0 ? done / elapsed : 0.0;
+    double percent = p->total ? 100.0 * done / p->total : 100.0;
+
+    char done_text[32], total_text[32], eta[32];
+    progressFormatBytes(done_text, sizeof(done_text), done);
+    progressFormatBytes(total_text, sizeof(total_text), p->total);
+    if (final) {
+        snprintf(eta, sizeof(eta), "%.1fs", elapsed);
+    } else if (rate > 0) {
+        uint64_t left = (uint64_t)((p->total - done) / rate);
+        snprintf(eta, sizeof(eta), "ETA %llu:%02llu",
+                 (unsigned long long)(left / 60), (unsigned long long)(left % 60));
+    } else {
+        snprintf(eta, sizeof(eta), "ETA --:--");
+    }
+
+    fprintf(stderr, "\r%s: %5.1f%% (%s / %s) %8.1f MB/s  %-12s%s",
+            p->label, percent, done_text, total_text, rate / 1e6, eta, final ? "\n" : "");
+    fflush(stderr);
+}
+
+static void *progressThread(void *arg) {
+    Progress *p = arg;
+
+    pthread_mutex_lock(&p->lock);
+    while (!p->stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += PROGRESS_INTERVAL_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&p->wake, &p->lock, &deadline);
+
+        if (p->active && !p->stop) progressRender(p, 0);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+/* Starts the render thread when enabled; a disabled meter costs nothing */
+int progressInit(Progress *p, int enabled) {
+    memset(p, 0, sizeof(Progress));
+    if (!enabled) return 1;
+
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->wake, NULL);
+    p->enabled = 1;
+
+    if (pthread_create(&p->thread, NULL, progressThread, p) != 0) {
+        fprintf(stderr, "Warning: Could not start progress thread\n");
+        return 0;
+    }
+    p->running = 1;
+
+#ifdef SCHED_IDLE
+    struct sched_param param = { 0 };
+    pthread_setschedparam(p->thread, SCHED_IDLE, &param);
+#endif
+    return 1;
+}
+
+void progressBegin(Progress *p, const char *label, uint64_t total) {
+    if (!p->enabled) return;
+
+    pthread_mutex_lock(&p->lock);
+    p->label = label;
+    p->total = total;
+    __atomic_store_n(&p->done, 0, __ATOMIC_RELAXED);
+    p->start_ns = progressNow();
+    p->active = 1;
+    progressRender(p, 0);
+    pthread_mutex_unlock(&p->lock);
+}
+
+/* Final line for the phase; stderr belongs to the caller afterwards */
+void progressEnd(Progress *p) {
+    if (!p->enabled || !p->active) return;
+
+    pthread_mutex_lock(&p->lock);
+    __atomic_store_n(&p->done, p->total, __ATOMIC_RELAXED);
+    progressRender(p, 1);
+    p->active = 0;
+    pthread_mutex_unlock(&p->lock);
+}
+
+void progressFree(Progress *p) {
+    if (!p->enabled) return;
+
+    pthread_mutex_lock(&p->lock);
+    p->stop = 1;
+    p->active = 0;
+    pthread_cond_signal(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+
+    if (p->running) pthread_join(p->thread, NULL);
+    pthread_cond_destroy(&p->wake);
+    pthread_mutex_destroy(&p->lock);
+    p->enabled = 0;
+    p->running = 0;
+}
+
+#endif /* PROGRESS_IMPLEMENTATION */
+
+#endif /* PROGRESS_H */
@@ -0,0 +1,287 @@
+/* stats.h - Single Header Per-Phase Timing and Statistics
+ *
+ * Tools wrap each phase in statsBegin()/statsEnd() and attach free-form
+ * metrics with statsSetValue(). The report is written as JSON for job
+ * orchestrators or as an aligned table for people. statsEnablePerf() adds
+ * hardware counters from perfcount.h to every phase, and each phase is
+ * also recorded as a span when trace.h recording is on.
+ *
+ * Usage:
+ *   #define STATS_IMPLEMENTATION
+ *   #include "stats.h"
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef STATS_IMPLEMENTATION
+#define PERFCOUNT_IMPLEMENTATION
+#define TRACE_IMPLEMENTATION
+#endif
+#include "perfcount.h"
+#include "probes.h"
+#include "trace.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STATS_MAX_PHASES 16
+#define STATS_MAX_VALUES 32
+
+typedef enum {
+    STATS_NONE,
+    STATS_TEXT,
+    STATS_JSON
+} StatsFormat;
+
+typedef struct {
+    const char *name;
+    uint64_t wall_ns;
+    uint64_t cpu_ns;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t counters[PERF_MAX_COUNTERS];
+} StatsPhase;
+
+typedef struct {
+    const char *key;
+    double value;
+} StatsValue;
+
+typedef struct {
+    const char *tool;
+    StatsPhase phases[STATS_MAX_PHASES];
+    int phase_count;
+    StatsValue values[STATS_MAX_VALUES];
+    int value_count;
+    int threads;
+    uint64_t start_wall, start_cpu;
+    uint64_t phase_wall, phase_cpu;
+    int perf_enabled;
+    PerfCounters perf;
+    uint64_t phase_counters[PERF_MAX_COUNTERS];
+} Stats;
+
+/* Stats Interface */
+int statsParseFormat(const char *arg, StatsFormat *format);
+void statsInit(Stats *stats, const char *tool);
+int statsEnablePerf(Stats *stats);
+void statsBegin(Stats *stats, const char *phase);
+void statsEnd(Stats *stats, uint64_t bytes_in, uint64_t bytes_out);
+void statsSetValue(Stats *stats, const char *key, double value);
+double statsPhaseSeconds(const Stats *stats, const char *phase);
+long statsPeakRssKb(void);
+void statsReport(FILE *fp, const Stats *stats, StatsFormat format);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* ============================================================================
+ * IMPLEMENTATION
+ * ============================================================================ */
+
+#ifdef STATS_IMPLEMENTATION
+
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+static uint64_t statsClock(clockid_t id) {
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* Accepts "--stats", "--stats=json" and "--stats=text" */
+int statsParseFormat(const char *arg, StatsFormat *format) {
+    if (strcmp(arg, "--stats") == 0 || strcmp(arg, "--stats=text") == 0) {
+        *format = STATS_TEXT;
+        return 1;
+    }
+    if (strcmp(arg, "--stats=json") == 0) {
+        *format = STATS_JSON;
+        return 1;
+    }
+    return 0;
+}
+
+void statsInit(Stats *stats, const char *tool) {
+    memset(stats, 0, sizeof(Stats));
+    stats->tool = tool;
+    stats->threads = 1;
+    stats->start_wall = statsClock(CLOCK_MONOTONIC);
+    stats->start_cpu = statsClock(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+/* Returns the number of hardware counters that could be opened */
+int statsEnablePerf(Stats *stats) {
+    stats->perf_enabled = perfOpen(&stats->perf) > 0;
+    return stats->perf.opened;
+}
+
+void statsBegin(Stats *stats, const char *phase) {
+    if (stats->phase_count >= STATS_MAX_PHASES) return;
+
+    stats->phases[stats->phase_count].name = phase;
+    HUFF_PROBE1(phase_start, phase);
+    if (stats->perf_enabled) perfRead(&stats->perf, stats->phase_counters);
+    stats->phase_wall = statsClock(CLOCK_MONOTONIC);
+    stats->phase_cpu = statsClock(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+/* A phase ended more than once (per-chunk loops) accumulates into the
+ * entry it got the first time */
+void statsEnd(Stats *stats, uint64_t bytes_in, uint64_t bytes_out) {
+    if (stats->phase_count >= STATS_MAX_PHASES) return;
+
+    StatsPhase *p = &stats->phases[stats->phase_count];
+    for (int i = 0; i < stats->phase_count; i++) {
+        if (strcmp(stats->phases[i].name, p->name) == 0) {
+            p = &stats->phases[i];
+            break;
+        }
+    }
+    if (p == &stats->phases[stats->phase_count]) {
+        memset(p->counters, 0, sizeof(p->counters));
+        p->wall_ns = p->cpu_ns = p->bytes_in = p->bytes_out = 0;
+        stats->phase_count++;
+    }
+
+    uint64_t now = statsClock(CLOCK_MONOTONIC);
+    uint64_t wall_ns = now - stats->phase_wall;
+    uint64_t cpu_ns = statsClock(CLOCK_PROCESS_CPUTIME_ID) - stats->phase_cpu;
+    p->wall_ns += wall_ns;
+    p->cpu_ns += cpu_ns;
+    p->bytes_in += bytes_in;
+    p->bytes_out += bytes_out;
+    HUFF_PROBE4(phase_done, p->name, wall_ns, cpu_ns, bytes_in);
+    traceSpan(p->name, "phase", stats->phase_wall, now, bytes_in);
+
+    if (stats->perf_enabled) {
+        uint64_t counters[PERF_MAX_COUNTERS];
+        perfRead(&stats->perf, counters);
+        for (int i = 0; i < PERF_MAX_COUNTERS; i++) {
+            p->counters[i] += counters[i] - stats->phase_counters[i];
+        }
+    }
+}
+
+void statsSetValue(Stats *stats, const char *key, double value) {
+    for (int i = 0; i < stats->value_count; i++) {
+        if (strcmp(stats->values[i].key, key) == 0) {
+            stats->values[i].value = value;
+            return;
+        }
+    }
+    if (stats->value_count >= STATS_MAX_VALUES) return;
+
+    stats->values[stats->value_count].key = key;
+    stats->values[stats->value_count].value = value;
+    stats->value_count++;
+}
+
+double statsPhaseSeconds(const Stats *stats, const char *phase) {
+    double total = 0;
+    for (int i = 0; i < stats->phase_count; i++) {
+        if (strcmp(stats->phases[i].name, phase) == 0) {
+            total += stats->phases[i].wall_ns / 1e9;
+        }
+    }
+    return total;
+}
+
+long statsPeakRssKb(void) {
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return -1;
+    return ru.ru_maxrss;
+}
+
+static double statsMBps(uint64_t bytes, uint64_t ns) {
+    return ns > 0 ? bytes / (ns / 1e9) / 1e6 : 0.0;
+}
+
+void statsReport(FILE *fp, const Stats *stats, StatsFormat format) {
+    uint64_t wall = statsClock(CLOCK_MONOTONIC) - stats->start_wall;
+    uint64_t cpu = statsClock(CLOCK_PROCESS_CPUTIME_ID) - stats->start_cpu;
+    double utilization = wall > 0 ? (double)cpu / wall / stats->threads : 0.0;
+    long rss = statsPeakRssKb();
+
+    if (format == STATS_JSON) {
+        fprintf(fp, "{\"tool\":\"%s\",\"wall_s\":%.6f,\"cpu_s\":%.6f,"
+                "\"peak_rss_kb\":%ld,\"threads\":%d,\"thread_utilization\":%.4f,",
+                stats->tool, wall / 1e9, cpu / 1e9, rss, stats->threads, utilization);
+
+        fprintf(fp, "\"phases\":[");
+        for (int i = 0; i < stats->phase_count; i++) {
+            const StatsPhase *p = &stats->phases[i];
+            fprintf(fp, "%s{\"name\":\"%s\",\"wall_s\":%.6f,\"cpu_s\":%.6f,"
+                    "\"bytes_in\":%llu,\"bytes_out\":%llu,\"mb_per_s\":%.3f",
+                    i ? "," : "", p->name, p->wall_ns / 1e9, p->cpu_ns / 1e9,
+                    (unsigned long long)p->bytes_in, (unsigned long long)p->bytes_out,
+                    statsMBps(p->bytes_in, p->wall_ns));
+            if (stats->perf_enabled) {
+                fprintf(fp, ",\"counters\":{");
+                int first = 1;
+                for (int c = 0; c < PERF_MAX_COUNTERS; c++) {
+                    if (!perfAvailable(&stats->perf, c)) continue;
+                    fprintf(fp, "%s\"%s\":%llu", first ? "" : ",", perfCounterName(c),
+                            (unsigned long long)p->counters[c]);
+                    first = 0;
+                }
+                fprintf(fp, "}");
+            }
+            fprintf(fp, "}");
+        }
+        fprintf(fp, "]");
+
+        for (int i = 0; i < stats->value_count; i++) {
+            fprintf(fp, ",\"%s\":%.10g", stats->values[i].key, stats->values[i].value);
+        }
+        fprintf(fp, "}\n");
+        return;
+    }
+
+    fprintf(fp, "%-12s %10s %10s %14s %14s %10s\n",
+            "phase", "wall ms", "cpu ms", "bytes in", "bytes out", "MB/s");
+    for (int i = 0; i < stats->phase_count; i++) {
+        const StatsPhase *p = &stats->phases[i];
+        fprintf(fp, "%-12s %10.3f %10.3f %14llu %14llu %10.1f\n",
+                p->name, p->wall_ns / 1e6, p->cpu_ns / 1e6,
+                (unsigned long long)p->bytes_in, (unsigned long long)p->bytes_out,
+                statsMBps(p->bytes_in, p->wall_ns));
+    }
+    fprintf(fp, "%-12s %10.3f %10.3f\n", "total", wall / 1e6, cpu / 1e6);
+    fprintf(fp, "Peak RSS:          %ld KiB\n", rss);
+    fprintf(fp, "Threads:           %d (%.1f%% utilized)\n", stats->threads, 100.0 * utilization);
+    for (int i = 0; i < stats->value_count; i++) {
+        fprintf(fp, "%-18s %.10g\n", stats->values[i].key, stats->values[i].value);
+    }
+
+    if (!stats->perf_enabled) return;
+
+    fprintf(fp, "\n%-12s", "phase");
+    for (int c = 0; c < PERF_MAX_COUNTERS; c++) {
+        if (perfAvailable(&stats->perf, c)) fprintf(fp, " %14s", perfCounterName(c));
+    }
+    fprintf(fp, " %8s\n", "IPC");
+    for (int i = 0; i < stats->phase_count; i++) {
+        const StatsPhase *p = &stats->phases[i];
+        fprintf(fp, "%-12s", p->name);
+        for (int c = 0; c < PERF_MAX_COUNTERS; c++) {
+            if (perfAvailable(&stats->perf, c)) {
+                fprintf(fp, " %14llu", (unsigned long long)p->counters[c]);
+            }
+        }
+        fprintf(fp, " %8.2f\n", p->counters[PERF_CYCLES] > 0 ?
+                (double)p->counters[PERF_INSTRUCTIONS] / p->counters[PERF_CYCLES] : 0.0);
+    }
+}
+
+#endif /* STATS_IMPLEMENTATION */
+
+#endif /* STATS_H */
@@ -0,0 +1,214 @@
+/* test_pqueue.c - Checks the PQ_DEFINE heaps against qsort
+ *
+ * Every sequence of minimums a heap hands out must match the same items
+ * sorted by qsort, whether the heap was filled by Push or Build and
+ * whether or not ReplaceTop was mixed in. PQ4 is checked on packed
+ * (key, id) items, and a Pair heap ordered by key alone checks that a
+ * LESS with ties still yields keys in order and loses no item. Keys are
+ * drawn from small ranges so most of them collide. Sizes around the
+ * 4-child groups catch partial groups.
+ *
+ *   make check
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#define PQUEUE_IMPLEMENTATION
+#include "pqueue.h"
+
+typedef struct {
+    uint32_t key;
+    uint32_t id;
+} Pair;
+
+#define PAIR_LESS(a, b) ((a).key < (b).key)
+PQ_DEFINE(PairHeap, Pair, PAIR_LESS)
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+/* xorshift64: the sequence, and so any failure, is the same every run */
+static uint32_t rngNext(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (uint32_t)(rng_state >> 32);
+}
+
+static int compareItems(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* n items with keys below key_range and ids up to n, so small ranges
+ * also repeat whole items */
+static void fillItems(uint64_t *items, size_t n, uint32_t key_range) {
+    for (size_t i = 0; i < n; i++) {
+        items[i] = PQ4_ITEM(rngNext() % key_range, rngNext() % (uint32_t)(n + 1));
+    }
+}
+
+/* The children of every slot must share one 32-byte group */
+static int groupsAligned(const PQ4 *pq) {
+    return pq->cap < 2 || (uintptr_t)&pq->heap[1] % 32 == 0;
+}
+
+/* Drain pq and compare with the sorted items */
+static int drainMatches(PQ4 *pq, const uint64_t *sorted, size_t n, const char *what) {
+    for (size_t i = 0; i < n; i++) {
+        uint64_t item;
+        if (!PQ4Pop(pq, &item)) {
+            fprintf(stderr, "Error: %s: heap empty after %zu of %zu items\n", what, i, n);
+            return 0;
+        }
+        if (item != sorted[i]) {
+            fprintf(stderr, "Error: %s: item %zu of %zu is (%u, %u), expected (%u, %u)\n", what, i, n,
+                    PQ4_KEY(item), PQ4_ID(item), PQ4_KEY(sorted[i]), PQ4_ID(sorted[i]));
+            return 0;
+        }
+    }
+    uint64_t extra;
+    if (!PQ4Empty(pq) || PQ4Pop(pq, &extra) || PQ4Top(pq)) {
+        fprintf(stderr, "Error: %s: heap not empty after %zu items\n", what, n);
+        return 0;
+    }
+    return 1;
+}
+
+/* Push into a heap that grows on demand, and into one reserved up front
+ * that must then never move */
+static int checkPush(const uint64_t *items, const uint64_t *sorted, size_t n) {
+    PQ4 grown, reserved;
+    PQ4Init(&grown);
+    PQ4Init(&reserved);
+    int ok = PQ4Reserve(&reserved, n);
+    const uint64_t *heap = reserved.heap;
+    for (size_t i = 0; i < n && ok; i++) ok = PQ4Push(&grown, items[i]) && PQ4Push(&reserved, items[i]);
+    if (ok && (reserved.heap != heap || !groupsAligned(&grown) || !groupsAligned(&reserved))) {
+        fprintf(stderr, "Error: push: heap of %zu moved or lost its group alignment\n", n);
+        ok = 0;
+    }
+    if (ok && PQ4Size(&grown) != n) {
+        fprintf(stderr, "Error: push: size %zu after %zu items\n", PQ4Size(&grown), n);
+        ok = 0;
+    }
+    ok = ok && drainMatches(&grown, sorted, n, "push") && drainMatches(&reserved, sorted, n, "reserve");
+    PQ4Free(&grown);
+    PQ4Free(&reserved);
+    return ok;
+}
+
+/* Build twice into one heap: the second build must replace the first */
+static int checkBuild(const uint64_t *items, const uint64_t *sorted, size_t n) {
+    PQ4 pq;
+    PQ4Init(&pq);
+    int ok = PQ4Build(&pq, sorted, n / 2) && PQ4Build(&pq, items, n) && groupsAligned(&pq) &&
+             drainMatches(&pq, sorted, n, "build");
+    PQ4Free(&pq);
+    return ok;
+}
+
+/* Replace the minimum n times; each returned minimum must be the
+ * smallest of the items currently in the heap, tracked in ref */
+static int checkReplace(const uint64_t *items, size_t n, uint32_t key_range) {
+    PQ4 pq;
+    PQ4Init(&pq);
+    uint64_t extra = 0;
+    if (n == 0) return !PQ4ReplaceTop(&pq, extra, &extra);
+
+    uint64_t *ref = malloc(n * sizeof(uint64_t));
+    int ok = ref && PQ4Build(&pq, items, n);
+    for (size_t i = 0; i < n && ok; i++) ref[i] = items[i];
+
+    for (size_t round = 0; round < n && ok; round++) {
+        size_t m = 0;
+        for (size_t i = 1; i < n; i++) {
+            if (ref[i] < ref[m]) m = i;
+        }
+        uint64_t item = PQ4_ITEM(rngNext() % key_range, n + round), min = 0;
+        if (!PQ4ReplaceTop(&pq, item, &min) || min != ref[m]) {
+            fprintf(stderr, "Error: replaceTop: round %zu of %zu returned (%u, %u), expected (%u, %u)\n",
+                    round, n, PQ4_KEY(min), PQ4_ID(min), PQ4_KEY(ref[m]), PQ4_ID(ref[m]));
+            ok = 0;
+        }
+        ref[m] = item;
+    }
+
+    if (ok) {
+        qsort(ref, n, sizeof(uint64_t), compareItems);
+        ok = drainMatches(&pq, ref, n, "replaceTop");
+    }
+    free(ref);
+    PQ4Free(&pq);
+    return ok;
+}
+
+/* Ordered by key alone: keys must come out sorted, and sorting what came
+ * out by (key, id) must give back every item */
+static int checkPairs(const uint64_t *items, const uint64_t *sorted, size_t n) {
+    PairHeap pq;
+    PairHeapInit(&pq);
+    uint64_t *out = malloc((n + 1) * sizeof(uint64_t));
+    int ok = out != NULL;
+    for (size_t i = 0; i < n && ok; i++) {
+        Pair p = { PQ4_KEY(items[i]), PQ4_ID(items[i]) };
+        ok = PairHeapPush(&pq, p);
+    }
+
+    for (size_t i = 0; i < n && ok; i++) {
+        Pair p = { 0, 0 };
+        if (!PairHeapPop(&pq, &p) || p.key != PQ4_KEY(sorted[i])) {
+            fprintf(stderr, "Error: pairs: key %zu of %zu out of order\n", i, n);
+            ok = 0;
+        }
+        out[i] = PQ4_ITEM(p.key, p.id);
+    }
+    if (ok) {
+        qsort(out, n, sizeof(uint64_t), compareItems);
+        for (size_t i = 0; i < n && ok; i++) {
+            if (out[i] != sorted[i]) {
+                fprintf(stderr, "Error: pairs: item %zu of %zu lost\n", i, n);
+                ok = 0;
+            }
+        }
+    }
+    ok = ok && PairHeapEmpty(&pq);
+    free(out);
+    PairHeapFree(&pq);
+    return ok;
+}
+
+int main(void) {
+    static const size_t sizes[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 16, 17, 21, 64, 85, 86, 1000, 4097, 100000 };
+    static const uint32_t key_ranges[] = { 1, 2, 7, 256, 1u << 31 };
+    int checks = 0;
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t n = sizes[s];
+        uint64_t *items = malloc((n + 1) * sizeof(uint64_t));
+        uint64_t *sorted = malloc((n + 1) * sizeof(uint64_t));
+        if (!items || !sorted) {
+            fprintf(stderr, "Error: Cannot allocate %zu test items\n", n);
+            return 1;
+        }
+
+        for (size_t r = 0; r < sizeof(key_ranges) / sizeof(key_ranges[0]); r++) {
+            fillItems(items, n, key_ranges[r]);
+            for (size_t i = 0; i < n; i++) sorted[i] = items[i];
+            qsort(sorted, n, sizeof(uint64_t), compareItems);
+
+            if (!checkPush(items, sorted, n) || !checkBuild(items, sorted, n) ||
+                (n <= 4097 && !checkReplace(items, n, key_ranges[r])) || !checkPairs(items, sorted, n)) {
+                fprintf(stderr, "Error: pqueue failed with %zu items, keys below %u\n", n, key_ranges[r]);
+                return 1;
+            }
+            checks++;
+        }
+
+        free(items);
+        free(sorted);
+    }
+
+    printf("pqueue: %d C checks passed\n", checks);
+    return 0;
+}
@@ -0,0 +1,128 @@
+/* test_pqueue_cxx.cc - Checks the PQueue template against std::sort
+ *
+ * The C++ side of test_pqueue.c: push/pop and build on random keys with
+ * heavy duplication must give the sorted sequence, with the default
+ * std::less, with std::greater, and on a movable element type ordered by
+ * key alone.
+ *
+ *   make check
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "pqueue.h"
+
+typedef std::pair<uint32_t, std::string> Named;
+
+struct KeyLess {
+    bool operator()(const Named &a, const Named &b) const { return a.first < b.first; }
+};
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+/* xorshift64, as in test_pqueue.c */
+static uint32_t rngNext() {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (uint32_t)(rng_state >> 32);
+}
+
+/* Push everything, or build from it, then pop; the result must equal
+ * the items sorted by the same ordering */
+template <typename Less>
+static bool checkOrder(const std::vector<uint64_t> &items, Less less, bool build, const char *what) {
+    PQueue<uint64_t, Less> pq(less);
+    if (build) {
+        pq.build(items.begin(), items.end());
+    } else {
+        pq.reserve(items.size());
+        for (uint64_t item : items) pq.push(item);
+    }
+
+    std::vector<uint64_t> sorted(items);
+    std::sort(sorted.begin(), sorted.end(), less);
+    for (size_t i = 0; i < sorted.size(); i++) {
+        if (pq.size() != sorted.size() - i || pq.top() != sorted[i]) {
+            fprintf(stderr, "Error: %s: item %zu of %zu is wrong\n", what, i, sorted.size());
+            return false;
+        }
+        uint64_t item = pq.pop();
+        if (item != sorted[i]) {
+            fprintf(stderr, "Error: %s: pop %zu of %zu is wrong\n", what, i, sorted.size());
+            return false;
+        }
+    }
+    if (!pq.empty()) {
+        fprintf(stderr, "Error: %s: heap not empty after %zu items\n", what, sorted.size());
+        return false;
+    }
+    return true;
+}
+
+/* Ordered by key alone: keys must come out sorted, and the strings,
+ * moved through the heap, must all come back */
+static bool checkNamed(const std::vector<uint64_t> &items) {
+    std::vector<Named> named;
+    for (uint64_t item : items) named.push_back(Named(PQ4_KEY(item), std::to_string(PQ4_ID(item))));
+
+    PQueue<Named, KeyLess> pq;
+    for (size_t i = 0; i < named.size(); i++) {
+        if (i % 2) pq.push(named[i]);
+    }
+    PQueue<Named, KeyLess> rest;
+    std::vector<Named> evens;
+    for (size_t i = 0; i < named.size(); i += 2) evens.push_back(named[i]);
+    rest.build(evens.begin(), evens.end());
+    while (!rest.empty()) pq.push(rest.pop());
+
+    std::vector<Named> out;
+    while (!pq.empty()) {
+        out.push_back(pq.pop());
+        if (out.size() > 1 && out[out.size() - 1].first < out[out.size() - 2].first) {
+            fprintf(stderr, "Error: named: key %zu of %zu out of order\n", out.size() - 1, named.size());
+            return false;
+        }
+    }
+
+    std::sort(out.begin(), out.end());
+    std::sort(named.begin(), named.end());
+    if (out != named) {
+        fprintf(stderr, "Error: named: %zu items did not all come back\n", named.size());
+        return false;
+    }
+    return true;
+}
+
+int main() {
+    static const size_t sizes[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 16, 17, 21, 64, 85, 86, 1000, 4097, 100000 };
+    static const uint32_t key_ranges[] = { 1, 2, 7, 256, 1u << 31 };
+    int checks = 0;
+
+    for (size_t n : sizes) {
+        for (uint32_t key_range : key_ranges) {
+            std::vector<uint64_t> items(n);
+            for (uint64_t &item : items) {
+                item = PQ4_ITEM(rngNext() % key_range, rngNext() % (uint32_t)(n + 1));
+            }
+
+            if (!checkOrder(items, std::less<uint64_t>(), false, "push") ||
+                !checkOrder(items, std::less<uint64_t>(), true, "build") ||
+                !checkOrder(items, std::greater<uint64_t>(), false, "push greater") ||
+                !checkOrder(items, std::greater<uint64_t>(), true, "build greater") ||
+                !checkNamed(items)) {
+                fprintf(stderr, "Error: PQueue failed with %zu items, keys below %u\n", n, key_range);
+                return 1;
+            }
+            checks++;
+        }
+    }
+
+    printf("pqueue: %d C++ checks passed\n", checks);
+    return 0;
+}
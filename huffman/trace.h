@@ -0,0 +1,190 @@
+/* trace.h - Single Header Chrome Trace-Event Recorder
+ *
+ * traceSpan() appends a complete ("X") event to a ring owned by the
+ * calling thread, so recording takes no locks; rings are claimed from a
+ * fixed table with one atomic increment the first time a thread records.
+ * When a ring fills, the oldest events are overwritten. traceClose() (or
+ * exit, via atexit) writes every ring as trace-event JSON, one track per
+ * thread, loadable in chrome://tracing or Perfetto. Nothing is recorded
+ * until traceOpen() is called.
+ *
+ * Usage:
+ *   #define TRACE_IMPLEMENTATION
+ *   #include "trace.h"
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TRACE_MAX_THREADS 64
+#define TRACE_RING_EVENTS (1 << 16)
+
+/* Trace Interface */
+int traceOpen(const char *path);
+int traceEnabled(void);
+uint64_t traceNow(void);
+void traceSpan(const char *name, const char *cat, uint64_t start_ns, uint64_t end_ns, uint64_t bytes);
+void traceThreadName(const char *name);
+int traceClose(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* ============================================================================
+ * IMPLEMENTATION
+ * ============================================================================ */
+
+#ifdef TRACE_IMPLEMENTATION
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    const char *name;
+    const char *cat;
+    uint64_t start_ns;
+    uint64_t dur_ns;
+    uint64_t bytes;
+} TraceEvent;
+
+typedef struct {
+    const char *thread_name;
+    uint64_t head;      /* events ever written; the ring keeps the last TRACE_RING_EVENTS */
+    TraceEvent events[TRACE_RING_EVENTS];
+} TraceRing;
+
+static TraceRing *trace_rings[TRACE_MAX_THREADS];
+static int trace_ring_count = 0;
+static __thread TraceRing *trace_ring = NULL;
+static int trace_enabled = 0;
+static const char *trace_path = NULL;
+static uint64_t trace_epoch = 0;
+
+uint64_t traceNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+int traceEnabled(void) {
+    return trace_enabled;
+}
+
+/* This thread's ring, claimed on first use; NULL once the table is full */
+static TraceRing *traceThreadRing(void) {
+    if (trace_ring) return trace_ring;
+
+    int slot = __atomic_fetch_add(&trace_ring_count, 1, __ATOMIC_RELAXED);
+    if (slot >= TRACE_MAX_THREADS) return NULL;
+
+    TraceRing *ring = calloc(1, sizeof(TraceRing));
+    if (!ring) return NULL;
+    __atomic_store_n(&trace_rings[slot], ring, __ATOMIC_RELEASE);
+    trace_ring = ring;
+    return ring;
+}
+
+void traceSpan(const char *name, const char *cat, uint64_t start_ns, uint64_t end_ns, uint64_t bytes) {
+    if (!trace_enabled) return;
+
+    TraceRing *ring = traceThreadRing();
+    if (!ring) return;
+
+    TraceEvent *e = &ring->events[ring->head % TRACE_RING_EVENTS];
+    e->name = name;
+    e->cat = cat;
+    e->start_ns = start_ns;
+    e->dur_ns = end_ns > start_ns ? end_ns - start_ns : 0;
+    e->bytes = bytes;
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+void traceThreadName(const char *name) {
+    if (!trace_enabled) return;
+
+    TraceRing *ring = traceThreadRing();
+    if (ring) ring->thread_name = name;
+}
+
+static void traceAtExit(void) {
+    traceClose();
+}
+
+/* Start recording; the JSON is written to path by traceClose() */
+int traceOpen(const char *path) {
+    static int registered = 0;
+
+    trace_path = path;
+    trace_epoch = traceNow();
+    trace_enabled = 1;
+    if (!registered) {
+        atexit(traceAtExit);
+        registered = 1;
+    }
+    traceThreadName("main");
+    return 1;
+}
+
+/* Writers must be idle; returns 0 if the file could not be written */
+int traceClose(void) {
+    if (!trace_enabled) return 1;
+    trace_enabled = 0;
+
+    FILE *fp = fopen(trace_path, "w");
+    if (!fp) {
+        perror("Error opening trace file");
+        return 0;
+    }
+
+    int pid = (int)getpid();
+    int rings = __atomic_load_n(&trace_ring_count, __ATOMIC_RELAXED);
+    if (rings > TRACE_MAX_THREADS) rings = TRACE_MAX_THREADS;
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    int first = 1;
+    for (int t = 0; t < rings; t++) {
+        TraceRing *ring = __atomic_load_n(&trace_rings[t], __ATOMIC_ACQUIRE);
+        if (!ring) continue;
+
+        fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                "\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", pid, t + 1, ring->thread_name ? ring->thread_name : "worker");
+        first = 0;
+
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t tail = head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : 0;
+        for (uint64_t i = tail; i < head; i++) {
+            const TraceEvent *e = &ring->events[i % TRACE_RING_EVENTS];
+            double ts = e->start_ns >= trace_epoch ? (e->start_ns - trace_epoch) / 1e3 : 0.0;
+            fprintf(fp, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                    "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"bytes\":%llu}}",
+                    e->name, e->cat, pid, t + 1, ts, e->dur_ns / 1e3,
+                    (unsigned long long)e->bytes);
+        }
+    }
+    fprintf(fp, "\n]}\n");
+
+    int ok = fclose(fp) == 0;
+    if (!ok) fprintf(stderr, "Error: Could not write trace file '%s'\n", trace_path);
+
+    for (int t = 0; t < rings; t++) {
+        free(trace_rings[t]);
+        trace_rings[t] = NULL;
+    }
+    trace_ring_count = 0;
+    trace_ring = NULL;
+    return ok;
+}
+
+#endif /* TRACE_IMPLEMENTATION */
+
+#endif /* TRACE_H */
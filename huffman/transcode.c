@@ -0,0 +1,488 @@
+/* transcode.c - Convert huffman-00 Archives to HUFF v1 Without a Round Trip */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define HUFF_IMPLEMENTATION
+#define LEGACY_IMPLEMENTATION
+#include "huff.h"
+#include "legacy.h"
+
+#define PIPE_BLOCK (1 << 20)    /* decoded bytes per hand-off */
+#define PIPE_DEPTH 4            /* blocks in flight between the two threads */
+#define MAX_JOBS 64
+
+/* Decode thread -> encode thread hand-off: a ring of PIPE_DEPTH blocks.
+ * The decoder fills block (head + count) % PIPE_DEPTH; the encoder owns
+ * block head until it releases it. */
+typedef struct {
+    uint8_t *blocks[PIPE_DEPTH];
+    size_t lens[PIPE_DEPTH];
+    int head;
+    int count;
+    int finished;       /* decoder is done, successfully or not */
+    int failed;         /* either side hit an error; both stop */
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+
+    /* Decoder side */
+    FILE *in;
+    HuffDecoder dec;
+    uint64_t original_size;
+    uint64_t payload;
+} Pipe;
+
+/* One file's outcome, for the batch summary */
+typedef struct {
+    const char *in_path;
+    char *out_path;
+    int status;         /* 0 = transcoded, 1 = skipped, -1 = failed */
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+} Job;
+
+static int force = 0;
+static int verbose = 0;
+static int margin = 0;
+
+/* Decode thread: stream the legacy payload through the decoder and hand
+ * each decoded block over to the encoder */
+static void *decodeThread(void *arg) {
+    Pipe *p = arg;
+    HuffStreamDecoder stream;
+    int ok = streamDecoderInit(&stream, &p->dec, p->in, p->payload, 0, PIPE_BLOCK);
+    if (!ok) fprintf(stderr, "Error: Cannot allocate %zu-byte input buffer\n", stream.cap);
+
+    for (uint64_t done = 0; ok && done < p->original_size; ) {
+        uint64_t n = p->original_size - done < PIPE_BLOCK ? p->original_size - done : PIPE_BLOCK;
+
+        pthread_mutex_lock(&p->lock);
+        while (p->count == PIPE_DEPTH && !p->failed) pthread_cond_wait(&p->changed, &p->lock);
+        int slot = (p->head + p->count) % PIPE_DEPTH;
+        ok = !p->failed;
+        pthread_mutex_unlock(&p->lock);
+        if (!ok) break;
+
+        if (!streamDecoderFill(&stream, n, NULL)) {
+            fprintf(stderr, "Error: Could not read compressed data\n");
+            ok = 0;
+            break;
+        }
+        if (!streamDecoderRun(&stream, p->blocks[slot], n, NULL)) {
+            fprintf(stderr, "Error: Decompression failed\n");
+            ok = 0;
+            break;
+        }
+        done += n;
+
+        pthread_mutex_lock(&p->lock);
+        p->lens[slot] = n;
+        p->count++;
+        pthread_cond_broadcast(&p->changed);
+        pthread_mutex_unlock(&p->lock);
+    }
+
+    pthread_mutex_lock(&p->lock);
+    if (!ok) p->failed = 1;
+    p->finished = 1;
+    pthread_cond_broadcast(&p->changed);
+    pthread_mutex_unlock(&p->lock);
+    streamDecoderFree(&stream);
+    return NULL;
+}
+
+/* Encode side, on the calling thread: re-encode each block with the v1
+ * codes, count its symbols and stream the output out. Returns 0 on
+ * error (already reported). */
+static int encodeBlocks(Pipe *p, FILE *out, CodeEntry codes[], uint64_t counts[],
+                        BitBuffer *bits, uint64_t *written) {
+    uint64_t done = 0;
+    for (;;) {
+        pthread_mutex_lock(&p->lock);
+        while (p->count == 0 && !p->finished && !p->failed) pthread_cond_wait(&p->changed, &p->lock);
+        int ready = p->count > 0 && !p->failed;
+        int slot = p->head;
+        pthread_mutex_unlock(&p->lock);
+        if (!ready) break;
+
+        const uint8_t *data = p->blocks[slot];
+        size_t len = p->lens[slot];
+        uint32_t freq[MAXN];
+        buildFreqTable(data, len, freq);
+        for (int i = 0; i < MAXN; i++) counts[i] += freq[i];
+
+        int ok = compressAppend(bits, data, len, codes) != NULL;
+        done += len;
+        uint64_t put = 0;
+        if (ok) ok = bitBufferWrite(bits, out, done < p->original_size, &put);
+        if (!ok) fprintf(stderr, "Error: Could not write compressed data\n");
+        *written += put;
+
+        pthread_mutex_lock(&p->lock);
+        if (ok) {
+            p->head = (p->head + 1) % PIPE_DEPTH;
+            p->count--;
+        } else {
+            p->failed = 1;
+        }
+        pthread_cond_broadcast(&p->changed);
+        pthread_mutex_unlock(&p->lock);
+        if (!ok) return 0;
+    }
+
+    pthread_mutex_lock(&p->lock);
+    int ok = !p->failed && done == p->original_size;
+    pthread_mutex_unlock(&p->lock);
+    return ok;
+}
+
+/* huffman-00 -> HUFF v1. The legacy stream is decoded on one thread and
+ * re-encoded on this one, block by block, so nothing but the output
+ * touches disk. The legacy file has no checksum; instead the symbols
+ * decoded must match its frequency table exactly, and the CRC of the
+ * decoded data goes into the new header. */
+static int transcodeLegacy(FILE *in, const LegacyHeader *legacy, uint64_t file_size, Job *job) {
+    uint32_t freq[MAXN];
+    uint64_t total = 0;
+    for (int i = 0; i < MAXN; i++) {
+        freq[i] = legacy->freq[i];
+        total += freq[i];
+    }
+    if (legacy->size == 0) {
+        fprintf(stderr, "Error: '%s' is empty, which HUFF v1 cannot represent\n", job->in_path);
+        return 0;
+    }
+    if (total != (uint64_t)legacy->size) {
+        fprintf(stderr, "Error: '%s' has per-symbol counts past 2^32, which HUFF v1 cannot store\n",
+                job->in_path);
+        return 0;
+    }
+
+    Node *legacy_root = legacyBuildTree(freq);
+    Node *root = buildHuffmanTree(freq);
+    Pipe p;
+    memset(&p, 0, sizeof(Pipe));
+    int ok = legacy_root && root && decoderInit(&p.dec, legacy_root, legacy->size);
+    if (!ok) {
+        fprintf(stderr, "Error: Could not rebuild Huffman trees for '%s'\n", job->in_path);
+        freeTree(legacy_root);
+        freeTree(root);
+        return 0;
+    }
+    decoderEnableChecksum(&p.dec);
+    p.in = in;
+    p.original_size = legacy->size;
+    p.payload = file_size - sizeof(LegacyHeader);
+
+    CodeEntry codes[MAXN];
+    buildCodes(root, codes);
+    BitBuffer *bits = bitBufferInit(BITBUFFER_CHUNK);
+    if (bits && margin) bitBufferTrackMargin(bits);
+    for (int i = 0; i < PIPE_DEPTH; i++) {
+        p.blocks[i] = memAlloc(PIPE_BLOCK);
+        if (!p.blocks[i]) ok = 0;
+    }
+    if (!bits || !ok) {
+        fprintf(stderr, "Error: Cannot allocate transcode buffers\n");
+        ok = 0;
+    }
+
+    FILE *out = ok ? fopen(job->out_path, "wb") : NULL;
+    if (ok && !out) {
+        fprintf(stderr, "Error opening output file '%s': %s\n", job->out_path, strerror(errno));
+        ok = 0;
+    }
+
+    /* Header is rewritten once the compressed size and checksum are known */
+    HuffHeader header = {
+        .magic = MAGIC_NUMBER,
+        .version = VERSION,
+        .original_size = legacy->size,
+        .compressed_size = 0,
+        .checksum = 0,
+        .tree_size = 0,
+        .padding_bits = 0,
+        .margin_code = 0
+    };
+    uint16_t tree_size = 0;
+    if (ok && (!writeHeader(out, &header) || (tree_size = writeFreqTable(out, freq)) == 0)) {
+        fprintf(stderr, "Error: Could not write header\n");
+        ok = 0;
+    }
+
+    uint64_t counts[MAXN] = {0};
+    uint64_t written = 0;
+    if (ok) {
+        pthread_t thread;
+        pthread_mutex_init(&p.lock, NULL);
+        pthread_cond_init(&p.changed, NULL);
+        if (pthread_create(&thread, NULL, decodeThread, &p) != 0) {
+            fprintf(stderr, "Error: Could not start decode thread\n");
+            ok = 0;
+        } else {
+            ok = encodeBlocks(&p, out, codes, counts, bits, &written);
+            pthread_join(thread, NULL);
+            ok = ok && !p.failed;
+        }
+        pthread_cond_destroy(&p.changed);
+        pthread_mutex_destroy(&p.lock);
+    }
+
+    if (ok) {
+        for (int i = 0; i < MAXN; i++) {
+            if (counts[i] != freq[i]) {
+                fprintf(stderr, "Error: '%s' decodes to %llu of symbol %d but its table says %u\n",
+                        job->in_path, (unsigned long long)counts[i], i, freq[i]);
+                ok = 0;
+                break;
+            }
+        }
+    }
+
+    if (ok) {
+        header.compressed_size = written;
+        header.checksum = p.dec.checksum;
+        header.tree_size = tree_size;
+        header.padding_bits = bits->bits_used > 0 ? (8 - bits->bits_used) : 0;
+        header.margin_code = margin ? inPlaceMarginCode(&bits->margin, legacy->size, written) : 0;
+        if (fseek(out, 0, SEEK_SET) != 0 || !writeHeader(out, &header)) {
+            fprintf(stderr, "Error: Could not write header\n");
+            ok = 0;
+        }
+    }
+    if (out && fclose(out) != 0 && ok) {
+        fprintf(stderr, "Error closing output file '%s': %s\n", job->out_path, strerror(errno));
+        ok = 0;
+    }
+    if (out && !ok) remove(job->out_path);
+
+    job->bytes_out = written + sizeof(HuffHeader) + tree_size * sizeof(FreqEntry);
+    for (int i = 0; i < PIPE_DEPTH; i++) memFree(p.blocks[i]);
+    bitBufferFree(bits);
+    freeCodes(codes);
+    decoderFree(&p.dec);
+    freeTree(legacy_root);
+    freeTree(root);
+    return ok;
+}
+
+static void transcodeJob(Job *job) {
+    long file_size = getFileSize(job->in_path);
+    job->status = -1;
+    job->bytes_in = file_size > 0 ? file_size : 0;
+
+    if (!force && getFileSize(job->out_path) >= 0) {
+        fprintf(stderr, "Error: Output file '%s' already exists (use -f to overwrite)\n", job->out_path);
+        return;
+    }
+
+    FILE *in = fopen(job->in_path, "rb");
+    if (!in) {
+        fprintf(stderr, "Error opening input file '%s': %s\n", job->in_path, strerror(errno));
+        return;
+    }
+
+    /* Sniff as dec does: HUFF v1 is already current */
+    uint32_t magic = 0;
+    int current = fread(&magic, sizeof(magic), 1, in) == 1 && magic == MAGIC_NUMBER;
+    rewind(in);
+    LegacyHeader legacy;
+    if (current) {
+        if (verbose) fprintf(stderr, "%s: already HUFF v1, skipped\n", job->in_path);
+        job->status = 1;
+    } else if (!legacyReadHeader(in, &legacy) || !legacyPlausible(&legacy, job->bytes_in)) {
+        fprintf(stderr, "Error: '%s' is neither a huffman-00 nor a HUFF file\n", job->in_path);
+    } else if (transcodeLegacy(in, &legacy, job->bytes_in, job)) {
+        job->status = 0;
+        if (verbose) {
+            fprintf(stderr, "%s -> %s: %llu -> %llu bytes\n", job->in_path, job->out_path,
+                    (unsigned long long)job->bytes_in, (unsigned long long)job->bytes_out);
+        }
+    }
+    fclose(in);
+}
+
+/* Batch workers take the next job until none are left */
+typedef struct {
+    Job *jobs;
+    int count;
+    int next;
+} JobQueue;
+
+static void *jobWorker(void *arg) {
+    JobQueue *queue = arg;
+    for (;;) {
+        int i = __atomic_fetch_add(&queue->next, 1, __ATOMIC_RELAXED);
+        if (i >= queue->count) return NULL;
+        transcodeJob(&queue->jobs[i]);
+    }
+}
+
+/* Output name for a batch input: .enc is dropped, .huff added */
+static char *outputName(const char *dir, const char *name) {
+    size_t len = strlen(name);
+    if (len > 4 && strcmp(name + len - 4, ".enc") == 0) len -= 4;
+    char *path = memAlloc(strlen(dir) + len + 7);
+    if (path) sprintf(path, "%s/%.*s.huff", dir, (int)len, name);
+    return path;
+}
+
+/* Every regular file in in_dir becomes a job writing into out_dir */
+static Job *listJobs(const char *in_dir, const char *out_dir, int *count) {
+    DIR *dir = opendir(in_dir);
+    if (!dir) {
+        fprintf(stderr, "Error opening directory '%s': %s\n", in_dir, strerror(errno));
+        return NULL;
+    }
+
+    Job *jobs = NULL;
+    int n = 0, cap = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        char *in_path = memAlloc(strlen(in_dir) + strlen(entry->d_name) + 2);
+        if (!in_path) break;
+        sprintf(in_path, "%s/%s", in_dir, entry->d_name);
+        struct stat st;
+        if (stat(in_path, &st) != 0 || !S_ISREG(st.st_mode)) {
+            memFree(in_path);
+            continue;
+        }
+
+        if (n == cap) {
+            cap = cap ? cap * 2 : 16;
+            Job *grown = memRealloc(jobs, cap * sizeof(Job));
+            if (!grown) {
+                memFree(in_path);
+                break;
+            }
+            jobs = grown;
+        }
+        memset(&jobs[n], 0, sizeof(Job));
+        jobs[n].in_path = in_path;
+        jobs[n].out_path = outputName(out_dir, entry->d_name);
+        n++;
+    }
+    closedir(dir);
+    *count = n;
+    return jobs;
+}
+
+int main(int argc, char *argv[]) {
+    const char *input = NULL;
+    const char *output = NULL;
+    int threads = 0;
+
+    /* Parse command line arguments */
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--verbose") == 0) {
+            verbose = 1;
+        } else if (strcmp(argv[i], "-f") == 0 || strcmp(argv[i], "--force") == 0) {
+            force = 1;
+        } else if (strcmp(argv[i], "--in-place-margin") == 0) {
+            margin = 1;
+        } else if ((strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0) && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+            if (threads < 1 || threads > MAX_JOBS) {
+                fprintf(stderr, "Error: --jobs must be between 1 and %d\n", MAX_JOBS);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            printf("Usage: %s [options] <input> <output>\n", argv[0]);
+            printf("       %s [options] <input_dir> <output_dir>\n", argv[0]);
+            printf("Rewrites huffman-00 .enc files as HUFF v1 in a single pass: each file is\n");
+            printf("decoded and re-encoded in memory on two threads, and checked against its\n");
+            printf("frequency table. HUFF v1 inputs are already current and are skipped.\n");
+            printf("Options:\n");
+            printf("  -v, --verbose      Report each file\n");
+            printf("  -f, --force        Overwrite existing files\n");
+            printf("  --in-place-margin  Record the margin dec --in-place needs\n");
+            printf("  -j, --jobs N       Files transcoded at once in directory mode\n");
+            printf("                     (default: half the online CPUs)\n");
+            printf("  -h, --help         Show this help\n");
+            return 0;
+        } else if (!input) {
+            input = argv[i];
+        } else if (!output) {
+            output = argv[i];
+        }
+    }
+
+    if (!input || !output) {
+        fprintf(stderr, "Error: Input and output must both be given\n");
+        fprintf(stderr, "Use %s --help for usage information\n", argv[0]);
+        return 1;
+    }
+
+    /* Bind kernels, tables and cached CPU probes before any worker can
+     * race to do it */
+    init_crc32();
+    huffKernels();
+    cpuL1DataCacheSize();
+
+    struct stat st;
+    if (stat(input, &st) != 0) {
+        fprintf(stderr, "Error opening input '%s': %s\n", input, strerror(errno));
+        return 1;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        Job job = { .in_path = input, .out_path = (char *)output };
+        transcodeJob(&job);
+        return job.status < 0 ? 1 : 0;
+    }
+
+    if (mkdir(output, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Error creating directory '%s': %s\n", output, strerror(errno));
+        return 1;
+    }
+
+    JobQueue queue = { 0 };
+    queue.jobs = listJobs(input, output, &queue.count);
+    if (!queue.jobs && queue.count == 0) {
+        if (verbose) fprintf(stderr, "No files in '%s'\n", input);
+        return 0;
+    }
+
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 1 ? (int)(cpus / 2) : 1;
+        if (threads > MAX_JOBS) threads = MAX_JOBS;
+    }
+    if (threads > queue.count) threads = queue.count;
+
+    pthread_t workers[MAX_JOBS];
+    int started = 0;
+    for (; started < threads; started++) {
+        if (pthread_create(&workers[started], NULL, jobWorker, &queue) != 0) break;
+    }
+    if (started == 0) jobWorker(&queue);
+    for (int i = 0; i < started; i++) pthread_join(workers[i], NULL);
+
+    int done = 0, skipped = 0, failed = 0;
+    uint64_t bytes_in = 0, bytes_out = 0;
+    for (int i = 0; i < queue.count; i++) {
+        Job *job = &queue.jobs[i];
+        if (job->status == 0) {
+            done++;
+            bytes_in += job->bytes_in;
+            bytes_out += job->bytes_out;
+        } else if (job->status > 0) {
+            skipped++;
+        } else {
+            failed++;
+        }
+        memFree((char *)job->in_path);
+        memFree(job->out_path);
+    }
+    memFree(queue.jobs);
+
+    fprintf(stderr, "Transcoded %d file%s (%llu -> %llu bytes), skipped %d, failed %d\n",
+            done, done == 1 ? "" : "s", (unsigned long long)bytes_in, (unsigned long long)bytes_out,
+            skipped, failed);
+    return failed ? 1 : 0;
+}